@@ -39,8 +39,8 @@
 
 #include "easiTM1638.h"
 
-// A table of 7-segment character codes (47 in total).
-uint8_t TM1638::tmCharTable[] = {0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x67, // Numbers : 0-9.
+// A table of 7-segment character codes (47 in total), kept in flash.
+const uint8_t TM1638Base::tmCharTable[] PROGMEM = {0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x67, // Numbers : 0-9.
                                  0x77, 0x7c, 0x39, 0x5e, 0x79, 0x71,                         // Numbers : A, b, C, d, E, F.
                                  0x58, 0x6f, 0x74, 0x76, 0x10, 0x30, 0x1e, 0x38,             // Chars1  : c, g, h, H, i, I, J, L.
                                  0x54, 0x37, 0x73, 0x50, 0x78, 0x1c, 0x3e, 0x6e,             // Chars2  : n, N, P, r, t, u, U, y.
@@ -48,123 +48,174 @@ uint8_t TM1638::tmCharTable[] = {0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07,
                                  0x01, 0x40, 0x08, 0x63, 0x5c, 0x46, 0x70,                   // Specials: uDash, mDash, lDash, uBox, lBox, lBorder, rBorder.
                                  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40};                  // Segments: SegA, SegB, SegC, SegD, SegE, SegF, SegG.
 
-// A table to describe the physical to logical digit numbering.
-// This map assumes that the digits are logically addressed in the same order as they are physically built.
-uint8_t TM1638::tmDigitMapDefault[] = {0, 1, 2, 3, 4, 5, 6, 7};
+// The size of the character code table.
+const uint8_t TM1638Base::charTableSize = sizeof(tmCharTable);
+
+// A table of ASCII (0x20 - 0x7f) 7-segment character codes (96 in total), kept in flash.
+const uint8_t TM1638Base::tmAsciiTable[] PROGMEM = {ASCII_FONT38};
+
+// There is no default physical to logical digit mapping table, a nullptr digit map
+//   means that the digits are logically addressed in the same order as they are physically built.
 
 
 /**************************/
 /* Public Class Functions */
 /**************************/
 
-// Class constructor.
-TM1638::TM1638(uint8_t stbPin, uint8_t clkPin, uint8_t dataPin) {
-  _clkPin  = clkPin;                                      // Record the TM1638 clock pin.
-  _dataPin = dataPin;                                     // Record the TM1638 data pin.
-  _stbPin  = stbPin;                                      // Record the TM1638 strobe pin.
-  // Calculate the size of the character code table.
-  charTableSize = (sizeof(tmCharTable) / sizeof(*tmCharTable));
+// Class constructor - with the derived class's transport, display size, and storage (the display RAM values and then the digit values).
+TM1638Base::TM1638Base(TM1638Transport& transport, const TM1638Config* config, uint8_t* storage, uint8_t chipSize) {
+  _transport = &transport;                                // Use the derived class's transport...
+  _config = config;                                       // ...and display size.
+  _chipRAM = storage;
+  _registers = storage + chipSize;                        // Use our own digit values.
+}
+
+// Class constructor - with the default bit banged transport, storage for up to 8 digits, and all 16 display RAM addresses.
+TM1638::TM1638(uint8_t stbPin, uint8_t clkPin, uint8_t dataPin) : TM1638Base(_bitBang, &_size, _storage, 16), _bitBang(stbPin, clkPin, dataPin) {
+}
+
+// Class constructor - with a supplied transport.
+TM1638::TM1638(TM1638Transport& transport) : TM1638Base(transport, &_size, _storage, 16) {
 }
 
 // Set up the display and initialise it with defaults values - with the default digit map.
 void TM1638::begin(uint8_t numButtons, uint8_t numLEDs, uint8_t numDigits, uint8_t brightness) {
-  this->begin(tmDigitMapDefault, numButtons, numLEDs, numDigits, brightness);
+  this->configure(&_size, nullptr, numButtons, numLEDs, numDigits, brightness);
 }
 
 // Set up the display and initialise it with defaults values - with a supplied digit map.
 void TM1638::begin(uint8_t* tmDigitMap, uint8_t numButtons, uint8_t numLEDs, uint8_t numDigits, uint8_t brightness) {
-  _tmDigitMap = tmDigitMap;
+  this->configure(&_size, tmDigitMap, numButtons, numLEDs, numDigits, brightness);
+}
+
+// Check and record a display size and digit map set at runtime, then set up the display.
+void TM1638Base::configure(TM1638Config* size, uint8_t* tmDigitMap, uint8_t numButtons, uint8_t numLEDs, uint8_t numDigits, uint8_t brightness) {
+  size->digitMap = tmDigitMap;
   if(numLEDs > 0 && numLEDs <= MAX_LEDS38) {              // The TM1638 module supports up to 8 LEDs.
-    _numLEDs = numLEDs;
+    size->numLEDs = numLEDs;
   }
   else {
-    _numLEDs = 0;                                         // We have no TM1638 module LEDs.
+    size->numLEDs = 0;                                    // We have no TM1638 module LEDs.
   }
   if(numDigits > 0 && numDigits <= MAX_DIGITS38) {        // The TM1638 module supports up to 8 digits.
-    _numDigits = numDigits;
+    size->numDigits = numDigits;
   }
   else {
-    _numDigits = 1;                                       // We have only one TM1638 module digit.
+    size->numDigits = 1;                                  // We have only one TM1638 module digit.
   }
   if(numButtons > 0 && numButtons <= MAX_BUTTONS38) {     // The TM1638 module supports up to 8 buttons.
-    _numButtons = numButtons;
+    size->numButtons = numButtons;
   }
   else {
-    _numButtons = 0;                                      // We have no TM1638 module buttons.
+    size->numButtons = 0;                                 // We have no TM1638 module buttons.
   }
-  pinMode(_clkPin, OUTPUT);                               // Set up the clock pin for output.
-  pinMode(_dataPin, OUTPUT);                              // Set up the data pin for output.
-  pinMode(_stbPin, OUTPUT);                               // Set up the strobe pin for output.
+  this->initialise(brightness);
+}
+
+// Set up the display and initialise it with default values.
+void TM1638Base::initialise(uint8_t brightness) {
+  STATS_CALL38(STATS_BEGIN38);
+  uint32_t start;
+  _transport->begin();                                    // Set up the transport pins for output.
+  _chipKnown = 0;                                         // Nothing is known about what the TM1638 holds.
+  _chipMode = 0;
+  _chipCtrl = 0;
   this->displayClear();                                   // Clear the LEDS and display, all segments and decimal points.
+  _byteMicros = 0;
+  start = micros();
   this->displayBrightness(brightness);                    // Set the display to the chosen (or default) brightness.
+  this->tickLearn(start, 1);                              // Measure the time taken to send a byte, for tick().
 }
 
 // Turn the TM1638 display OFF.
-void TM1638::displayOff(void) {
+void TM1638Base::displayOff(void) {
+  STATS_CALL38(STATS_OFF38);
   cmdDispCtrl = DISP_OFF38;                               // 0x80 = display OFF.
-  this->writeCommand(cmdDispCtrl);                        // Turn the display OFF.
+  if(_batching) {
+    _ctrlPending = true;                                  // Turn the display OFF with the rest of the batch.
+  }
+  else {
+    this->writeCommand(cmdDispCtrl);                      // Turn the display OFF.
+  }
 }
 
 // Clear all the LEDs and digits (+dps) in the display.
-void TM1638::displayClear(void) {
+void TM1638Base::displayClear(void) {
+  STATS_CALL38(STATS_CLEAR38);
   uint8_t digit;
-  for(digit = 0; digit < _numDigits; digit++) {
-    this->displayLED1(digit, false);                      // Turn OFF all the TM1638 module LEDs.
-    this->displayChar(digit, 0x00, true);                 // Write a zero (all segments OFF) to each digit.
-    this->displayDP(digit, false);                        // Turn OFF all the decimal points.
+  *_LEDs = 0;                                             // Turn OFF all the TM1638 module LEDs.
+  _greenLEDs = 0;
+  for(digit = 0; digit < max(_config->numDigits, _config->numLEDs); digit++) {
+    if(digit < _config->numDigits) {
+      _registers[digit] = 0x00;                           // Turn OFF all the segments and decimal points.
+      this->markDigit(digit);
+    }
+    if(digit < _config->numLEDs) {
+      this->markDigit(digit, true);
+    }
   }
+  this->refresh();                                        // Write the cleared LEDs and digits to the display.
 }
 
 // Set the brightness (0x00 - 0x07) and turn the TM1638 display ON.
-void TM1638::displayBrightness(uint8_t brightness) {
-  _brightness = brightness & INTENSITY_MAX38;             // Record the TM1638 brightness level.
-  cmdDispCtrl = DISP_ON38 + _brightness;                  // 88 + 0 to 7 brightness, 88 = display ON.
-  this->writeCommand(cmdDispCtrl);                        // Set the brightness and turn the display ON.
+void TM1638Base::displayBrightness(uint8_t brightness) {
+  STATS_CALL38(STATS_BRIGHT38);
+  cmdDispCtrl = DISP_ON38 + (brightness & INTENSITY_MAX38); // 88 + 0 to 7 brightness, 88 = display ON.
+  if(_batching) {
+    _ctrlPending = true;                                  // Set the brightness with the rest of the batch.
+  }
+  else {
+    this->writeCommand(cmdDispCtrl);                      // Set the brightness and turn the display ON.
+  }
 }
 
 // Test the display - all the display LEDs and digit segments (+dps).
-void TM1638::displayTest(bool dispTest) {
+void TM1638Base::displayTest(bool dispTest) {
+  STATS_CALL38(STATS_TEST38);
   uint8_t digit;
-  this->writeCommand(ADDR_AUTO38);                        // Cmd to set auto incrementing address mode.
-  this->start();                                          // Send the start signal to the TM1638.
-  this->writeByte(STARTADDR38);                           // Set the address to the first digit.
   if(dispTest) {
     // Turn ON all the LEDs, and all digit segments (+dps).
-    for(digit = 0; digit < max(_numDigits, _numLEDs); digit++) {
+    this->writeCommand(ADDR_AUTO38);                      // Cmd to set auto incrementing address mode.
+    this->start();                                        // Send the start signal to the TM1638.
+    this->writeByte(STARTADDR38);                         // Set the address to the first digit.
+    for(digit = 0; digit < max(_config->numDigits, _config->numLEDs); digit++) {
       this->writeByte(0xff);                              // Direct write to turn all digit segments (+dps) ON.
-      this->writeByte(0x01);                              // Direct write to turn the LED ON.
+      this->writeByte(LED_BOTH38);                        // Direct write to turn the LED ON, in both colours.
+      _chipRAM[digit << 1] = 0xff;                        // Record what the TM1638 now holds.
+      _chipRAM[(digit << 1) + 1] = LED_BOTH38;
     }
+    this->stop();                                         // Send the stop signal to the TM1638.
+    _chipKnown |= (uint16_t)(((uint32_t)1 << (max(_config->numDigits, _config->numLEDs) << 1)) - 1);
   }
   else {
-    // Restore all the LEDs, and all digit segments (+dps) to their previous values.
-    for(digit = 0; digit < max(_numDigits, _numLEDs); digit++) {
-      this->writeByte( _registers[digit]);                // Restore the digit segments (+dps) to what they were.
-      this->writeByte((_allLEDs >> digit) & 0x01);        // Restore the LED to what it was.
-    }
+    // Restore all the LEDs, and all digit segments (+dps) to their previous values, through the digit map.
+    _dirtyRAM |= (uint16_t)(((uint32_t)1 << (max(_config->numDigits, _config->numLEDs) << 1)) - 1);
+    this->flush();                                        // Write the previous values back to the display.
   }
-  this->stop();                                           // Send the stop signal to the TM1638.
 }
 
 // Display a binary integer between 0b00000000 - 0b11111111, starting at digit 0 for the LSB or MSB.
-void TM1638::displayBin8(uint8_t number, bool lsbFirst) {
+void TM1638Base::displayBin8(uint8_t number, bool lsbFirst) {
+  STATS_CALL38(STATS_BIN838);
   uint8_t digit;
-  if(_numDigits > 7) {                                    // We need at least 8 digits to display an 8-bit binary number, leftmost digit is #0.
+  if(_config->numDigits > 7) {                            // We need at least 8 digits to display an 8-bit binary number, leftmost digit is #0.
     for(digit = 0; digit < 8; digit++) {
       if(lsbFirst) {
-        _registers[digit] = (_registers[digit] & DP_CTRL38) | (tmCharTable[(number >> digit) & 0x01] & 0x7f);
+        _registers[digit] = (_registers[digit] & DP_CTRL38) | (this->charCode((number >> digit) & 0x01) & 0x7f);
       }
       else {
-        _registers[digit] = (_registers[7 - digit] & DP_CTRL38) | (tmCharTable[(number >> (7 - digit)) & 0x01] & 0x7f);
+        _registers[digit] = (_registers[digit] & DP_CTRL38) | (this->charCode((number >> (7 - digit)) & 0x01) & 0x7f);
       }
-      this->writeCommand(ADDR_FIXED38);                   // Cmd to set specific address mode.
-      this->writeDigit(digit);                            // Write the digit of the 8-bit number to the display.
+      this->markDigit(digit);                             // Mark the digit of the 8-bit number as changed.
     }
+    this->refresh();                                      // Write the 8-bit number to the display.
   }
 }
 
 // Display a character in a specific digit.
-void TM1638::displayChar(uint8_t digit, uint8_t number, bool raw) {
-  if(digit < _numDigits) {                                // Boundry check the digit number, leftmost digit is #0.
+void TM1638Base::displayChar(uint8_t digit, uint8_t number, bool raw) {
+  STATS_CALL38(STATS_CHAR38);
+  if(digit < _config->numDigits) {                        // Boundry check the digit number, leftmost digit is #0.
     if(raw) {                                             // If this is a raw segment bit number, ensure there are only 7 bits.
       number &= 0x7f;
       number |= (_registers[digit] & DP_CTRL38);          // Merge the segment number with the dp (bit 7) status.
@@ -173,186 +224,1706 @@ void TM1638::displayChar(uint8_t digit, uint8_t number, bool raw) {
       if(number >= charTableSize) {
         number = 0x20;                                    // This is a 0x00 (space) in the character table.
       }
-      number = tmCharTable[number];                       // Get the raw number from the character table.
+      number = this->charCode(number);                    // Get the raw number from the character table.
       number |= (_registers[digit] & DP_CTRL38);          // Merge the segment number with the dp (bit 7) status.
     }
     _registers[digit] = number;                           // Record the latest value for this LED digit.
-    this->writeCommand(ADDR_FIXED38);                     // Cmd to set specific address mode.
-    this->writeDigit(digit);                              // Write the character digit to the display.
+    this->markDigit(digit);                               // Mark the character digit as changed.
+    this->refresh();                                      // Write the character digit to the display.
   }
 }
 
-// Display a decimal integer between 0 - 99, or a hex integer between 0x00 - 0xff, starting at a specific digit.
-void TM1638::displayInt8(uint8_t digit, uint8_t number, bool useDec) {
-  if(_numDigits > 1 && digit < (_numDigits - 1)) {        // We need at least 2 digits to display an 8-bit number, leftmost digit is #0.
-    if(useDec) {
-      if(number > 99) {                                   // Clip the number at the maximum for a 2 digit decimal number.
-        number = 99;
-      }
-      _registers[digit]     = (_registers[digit]     & DP_CTRL38) | (tmCharTable[(number / 10) % 10] & 0x7f);
-      _registers[digit + 1] = (_registers[digit + 1] & DP_CTRL38) | (tmCharTable[ number       % 10] & 0x7f);
-    }
-    else {
-      _registers[digit]     = (_registers[digit]     & DP_CTRL38) | (tmCharTable[(number / 16) % 16] & 0x7f);
-      _registers[digit + 1] = (_registers[digit + 1] & DP_CTRL38) | (tmCharTable[ number       % 16] & 0x7f);
-    }
-    this->writeCommand(ADDR_FIXED38);                     // Cmd to set specific address mode.
-    this->writeDigit(digit);                              // Write the first digit of the 8-bit number.
-    this->writeDigit(digit + 1);                          // Write the second digit of the 8-bit number.
+// Display a number of raw segment (+dp in b7) bytes, starting at a specific digit. The bytes are recorded and written
+//   together, in a single auto incrementing address burst (unless writing only the few that changed is cheaper).
+void TM1638Base::displayRaw(uint8_t digit, const uint8_t* segments, uint8_t length) {
+  STATS_CALL38(STATS_CHAR38);
+  uint8_t index;
+  // Boundry check the digit numbers, leftmost digit is #0.
+  for(index = 0; index < length && digit < _config->numDigits; index++, digit++) {
+    _registers[digit] = segments[index];                  // Record the raw segments, and dp, for this LED digit.
+    this->markDigit(digit);                               // Mark the digit as changed.
   }
+  this->refresh();                                        // Write the digits to the display.
+}
+
+// Display an ASCII string from RAM, starting at a specific digit.
+void TM1638Base::displayString(uint8_t digit, const char* text) {
+  this->displayText(digit, text, false);
+}
+
+// Display an ASCII string from flash, e.g. F("HELLO"), starting at a specific digit.
+void TM1638Base::displayString(uint8_t digit, const __FlashStringHelper* text) {
+  this->displayText(digit, reinterpret_cast<const char*>(text), true);
+}
+
+// Display a decimal integer between 0 - 99, or a hex integer between 0x00 - 0xff, starting at a specific digit.
+void TM1638Base::displayInt8(uint8_t digit, uint8_t number, bool useDec) {
+  this->displayNumber(digit, 2, number, useDec ? 10 : 16, NO_DP38, NUM_ZEROS38);
 }
 
 // Display a decimal integer between 0 - 999, or a hex integer between 0x000 - 0xfff, starting at a specific digit.
-void TM1638::displayInt12(uint8_t digit, uint16_t number, bool useDec) {
-  if(_numDigits > 2 && digit < (_numDigits - 2)) {        // We need at least 3 digits to display an 12-bit number, leftmost digit is #0.
-    if(useDec) {
-      if(number > 999) {                                  // Clip the number at the maximum for a 3 digit decimal number.
-        number = 999;
-      }
-      _registers[digit]     = (_registers[digit]     & DP_CTRL38) | (tmCharTable[(number / 100) % 10] & 0x7f);
-      _registers[digit + 1] = (_registers[digit + 1] & DP_CTRL38) | (tmCharTable[(number /  10) % 10] & 0x7f);
-      _registers[digit + 2] = (_registers[digit + 2] & DP_CTRL38) | (tmCharTable[ number        % 10] & 0x7f);
-    }
-    else {
-      if(number > 0xfff) {                                // Clip the number at the maximum for a 3 digit hexadecimal number.
-        number = 0xfff;
-      }
-      _registers[digit]     = (_registers[digit]     & DP_CTRL38) | (tmCharTable[(number / 256) % 16] & 0x7f);
-      _registers[digit + 1] = (_registers[digit + 1] & DP_CTRL38) | (tmCharTable[(number /  16) % 16] & 0x7f);
-      _registers[digit + 2] = (_registers[digit + 2] & DP_CTRL38) | (tmCharTable[ number        % 16] & 0x7f);
-    }
-    this->writeCommand(ADDR_FIXED38);                     // Cmd to set specific address mode.
-    this->writeDigit(digit);                              // Write the first digit of the 12-bit number.
-    this->writeDigit(digit + 1);                          // Write the second digit of the 12-bit number.
-    this->writeDigit(digit + 2);                          // Write the third digit of the 12-bit number.
-  }
+void TM1638Base::displayInt12(uint8_t digit, uint16_t number, bool useDec) {
+  this->displayNumber(digit, 3, number, useDec ? 10 : 16, NO_DP38, NUM_ZEROS38);
 }
 
 // Display a decimal integer between 0 - 9999, or a hex integer between 0x0000 - 0xffff, starting at a specific digit.
-void TM1638::displayInt16(uint8_t digit, uint16_t number, bool useDec) {
-  if(_numDigits > 3 && digit < (_numDigits - 3)) {        // We need at least 4 digits to display an 16-bit number, leftmost digit is #0.
-    if(useDec) {
-      if(number > 9999) {                                 // Clip the number at the maximum for a 4 digit decimal number.
-        number = 9999;
-      }
-      _registers[digit]     = (_registers[digit]     & DP_CTRL38) | (tmCharTable[(number / 1000) % 10] & 0x7f);
-      _registers[digit + 1] = (_registers[digit + 1] & DP_CTRL38) | (tmCharTable[(number /  100) % 10] & 0x7f);
-      _registers[digit + 2] = (_registers[digit + 2] & DP_CTRL38) | (tmCharTable[(number /   10) % 10] & 0x7f);
-      _registers[digit + 3] = (_registers[digit + 3] & DP_CTRL38) | (tmCharTable[ number         % 10] & 0x7f);
-    }
-    else {
-      _registers[digit]     = (_registers[digit]     & DP_CTRL38) | (tmCharTable[(number / 4096) % 16] & 0x7f);
-      _registers[digit + 1] = (_registers[digit + 1] & DP_CTRL38) | (tmCharTable[(number /  256) % 16] & 0x7f);
-      _registers[digit + 2] = (_registers[digit + 2] & DP_CTRL38) | (tmCharTable[(number /   16) % 16] & 0x7f);
-      _registers[digit + 3] = (_registers[digit + 3] & DP_CTRL38) | (tmCharTable[ number         % 16] & 0x7f);
+void TM1638Base::displayInt16(uint8_t digit, uint16_t number, bool useDec) {
+  this->displayNumber(digit, 4, number, useDec ? 10 : 16, NO_DP38, NUM_ZEROS38);
+}
+
+// Display a 32-bit integer in a field of digits, in base 2, 8, 10 or 16, with an optional decimal point and formatting flags.
+void TM1638Base::displayNumber(uint8_t digit, uint8_t width, int32_t number, uint8_t base, uint8_t dpPos, uint8_t flags) {
+  STATS_CALL38(STATS_NUMBER38);
+  uint8_t codes[MAX_DIGITS38];                            // The number digit segments, leftmost first.
+  uint8_t counter;
+  if(width == 0 || width > MAX_DIGITS38 || digit + width > _config->numDigits) {
+    return;                                               // The field must fit within the display, leftmost digit is #0.
+  }
+  if(!this->formatNumber(codes, width, number, base, dpPos, flags)) {
+    return;
+  }
+  for(counter = 0; counter < width; counter++) {
+    if(dpPos == NO_DP38) {
+      codes[counter] |= (_registers[digit + counter] & DP_CTRL38); // Keep the dp (bit 7) status.
     }
-    this->writeCommand(ADDR_FIXED38);                     // Cmd to set specific address mode.
-    this->writeDigit(digit);                              // Write the first digit of the 16-bit number.
-    this->writeDigit(digit + 1);                          // Write the second digit of the 16-bit number.
-    this->writeDigit(digit + 2);                          // Write the third digit of the 16-bit number.
-    this->writeDigit(digit + 3);                          // Write the fourth digit of the 16-bit number.
+    _registers[digit + counter] = codes[counter];
+    this->markDigit(digit + counter);                     // Mark the digit of the number as changed.
   }
+  this->refresh();                                        // Write the number to the display.
 }
 
 // Display a binary integer between 0b00000000 - 0b11111111 on the LEDs, starting at LED 0 for the LSB or MSB.
-void TM1638::displayLED8(uint8_t number, bool lsbFirst) {
+void TM1638Base::displayLED8(uint8_t number, bool lsbFirst) {
+  STATS_CALL38(STATS_LED838);
   uint8_t digit;
-  if(_numLEDs > 7) {                                      // We need at least 8 digits to display an 8-bit binary number, leftmost digit is #0.
+  if(_config->numLEDs > 7) {                              // We need at least 8 digits to display an 8-bit binary number, leftmost digit is #0.
     for(digit = 0; digit < 8; digit++) {
       if(lsbFirst) {
-        // Write the LSB -> MSB bit status to the LED.
-        this->displayLED1(digit, ((number >> digit) & 0x01));
+        // Record the LSB -> MSB bit status for the LED.
+        bitWrite(*_LEDs, digit, ((number >> digit) & 0x01));
       }
       else {
-        // Write the MSB -> LSB bit status to the LED.
-        this->displayLED1(digit, ((number >> (7 - digit)) & 0x01));
+        // Record the MSB -> LSB bit status for the LED.
+        bitWrite(*_LEDs, digit, ((number >> (7 - digit)) & 0x01));
       }
+      this->markDigit(digit, true);                       // Mark the LED as changed.
     }
+    this->refresh();                                      // Write all the LEDs to the display.
   }
 }
 
 // Turn ON/OFF the LED at a specific position.
-void TM1638::displayLED1(uint8_t digit, bool status) {
+void TM1638Base::displayLED1(uint8_t digit, bool status) {
+  STATS_CALL38(STATS_LED138);
   // Boundry check the digit number, leftmost digit is #0.
-  if(_numLEDs > 0 && digit < _numLEDs) {
-    bitWrite(_allLEDs, digit, status);
-    this->writeCommand(ADDR_FIXED38);                     // Cmd to set specific address mode.
-    this->writeDigit(digit, true);                        // Write the status to the specified LED.
+  if(_config->numLEDs > 0 && digit < _config->numLEDs) {
+    bitWrite(*_LEDs, digit, status);
+    this->markDigit(digit, true);                         // Mark the specified LED as changed.
+    this->refresh();                                      // Write the status to the specified LED.
   }
 }
 
  // Turn ON/OFF the decimal point in a specific digit.
-void TM1638::displayDP(uint8_t digit, bool status) {
+void TM1638Base::displayDP(uint8_t digit, bool status) {
+  STATS_CALL38(STATS_DP38);
   // Boundry check the digit number, leftmost digit is #0.
-  if(digit < _numDigits) {
+  if(digit < _config->numDigits) {
     bitWrite(_registers[digit], 7, status);
-    this->writeCommand(ADDR_FIXED38);                     // Cmd to set specific address mode.
-    this->writeDigit(digit);                              // Write the digit decimal point to the display.
+    this->markDigit(digit);                               // Mark the digit decimal point as changed.
+    this->refresh();                                      // Write the digit decimal point to the display.
+  }
+}
+
+// Set the colour (LED_OFF38, LED_RED38, LED_GREEN38 or LED_BOTH38) of the (bi-colour) LED at a specific position.
+void TM1638Base::displayLEDColour(uint8_t digit, uint8_t colour) {
+  STATS_CALL38(STATS_LED138);
+  // Boundry check the digit number, leftmost digit is #0.
+  if(_config->numLEDs > 0 && digit < _config->numLEDs) {
+    bitWrite(*_LEDs, digit, colour & LED_RED38);          // The SEG9 colour...
+    bitWrite(_greenLEDs, digit, colour & LED_GREEN38);    // ...and the SEG10 colour.
+    this->markDigit(digit, true);                         // Mark the specified LED as changed.
+    this->refresh();                                      // Write the colour to the specified LED.
+  }
+}
+
+// Set the colour of every (bi-colour) LED - bit n of the low byte is the SEG9 (red) colour, and bit n of the high byte
+//   is the SEG10 (green) colour, of LED n. All the changed LEDs are written in a single burst.
+void TM1638Base::displayLEDs(uint16_t colours) {
+  STATS_CALL38(STATS_LED838);
+  uint8_t digit;
+  for(digit = 0; digit < _config->numLEDs; digit++) {
+    bitWrite(*_LEDs, digit, (colours >> digit) & 0x01);
+    bitWrite(_greenLEDs, digit, (colours >> (digit + 8)) & 0x01);
+    this->markDigit(digit, true);                         // Mark the LED as changed.
   }
+  this->refresh();                                        // Write all the LEDs to the display.
+}
+
+// Turn ON/OFF the LED at a specific position from an interrupt - the bus is never touched here, the change is left pending
+//   and merged by the sketch's next flush(), tick() or TM1638Async::commit(), between bus transactions.
+void TM1638Base::displayLED1FromISR(uint8_t digit, bool status) {
+  uint8_t mask;
+  // Boundry check the digit number, leftmost digit is #0.
+  if(_config->numLEDs > 0 && digit < _config->numLEDs) {
+    mask = (uint8_t)1 << digit;
+    _isrLEDs = status ? (_isrLEDs | mask) : (_isrLEDs & ~mask);
+    if(!((_isrLEDsFlag ^ _isrLEDsSeen) & mask)) {
+      _isrLEDsFlag ^= mask;                               // The LED was not already pending, so make it pending.
+    }
+  }
+}
+
+// Turn ON/OFF the decimal point in a specific digit from an interrupt - the change is merged as for displayLED1FromISR().
+void TM1638Base::displayDPFromISR(uint8_t digit, bool status) {
+  uint8_t mask;
+  // Boundry check the digit number, leftmost digit is #0.
+  if(digit < _config->numDigits) {
+    mask = (uint8_t)1 << digit;
+    _isrDPs = status ? (_isrDPs | mask) : (_isrDPs & ~mask);
+    if(!((_isrDPsFlag ^ _isrDPsSeen) & mask)) {
+      _isrDPsFlag ^= mask;                                // The decimal point was not already pending, so make it pending.
+    }
+  }
+}
+
+// Use a caller owned buffer for the digit values (a byte per digit, the segments with the dp in b7), and optionally
+//   a byte for the LED values (a bit per LED), instead of our own - nullptr for our own. The display functions record their
+//   changes in the caller's buffer, and the caller can render into it directly, then call displayBuffer().
+void TM1638Base::attachBuffer(uint8_t* digits, uint8_t* LEDs) {
+  _registers = digits ? digits : _chipRAM + _config->chipSize;
+  _LEDs = LEDs ? LEDs : &_allLEDs;
+  this->displayBuffer();                                  // Show what the buffer holds.
+}
+
+// Write the changes the caller has made to the attached buffer to the display - only the bytes the TM1638 does not already hold are sent.
+void TM1638Base::displayBuffer(void) {
+  STATS_CALL38(STATS_FLUSH38);
+  uint8_t digit;
+  for(digit = 0; digit < max(_config->numDigits, _config->numLEDs); digit++) {
+    if(digit < _config->numDigits) {
+      this->markDigit(digit);                             // Mark every digit...
+    }
+    if(digit < _config->numLEDs) {
+      this->markDigit(digit, true);                       // ...and LED as changed, the unchanged ones are dropped by flush().
+    }
+  }
+  this->refresh();                                        // Write the changes to the display.
+}
+
+// Start a batch of display updates - the display functions only record their changes until endUpdate() or flush().
+void TM1638Base::beginUpdate(void) {
+  _batching = true;
+}
+
+// Finish a batch of display updates and write all the changed LEDs and digits to the display.
+void TM1638Base::endUpdate(void) {
+  _batching = false;
+  this->flush();
+}
+
+// Write all the changed LEDs and digits (+dps) to the display.
+void TM1638Base::flush(void) {
+  STATS_CALL38(STATS_FLUSH38);
+  uint8_t address, first, last, changed = 0;
+  if(_ctrlPending) {
+    _ctrlPending = false;
+    this->writeCommand(cmdDispCtrl);                      // Send the batched brightness, or display ON/OFF.
+  }
+  this->mergeISR();                                       // Add the LED and dp changes made from an interrupt.
+  this->elide();                                          // Drop the changes that the TM1638 already holds.
+  if(this->dirtyRange(&first, &last)) {
+    for(address = first; address <= last; address++) {
+      changed += (_dirtyRAM >> address) & 0x01;           // Count the changes in the range.
+    }
+    if((last - first) <= (changed << 1)) {
+      // The changes are close together, so write the whole range in a single auto incrementing address burst.
+      this->writeCommand(ADDR_AUTO38);                    // Cmd to set auto incrementing address mode.
+      this->writeBurst(first, last);
+    }
+    else {
+      // The changes are spread out, so write only the changed addresses - a single byte write works the same in
+      //   either addressing mode, so the auto incrementing address mode is kept if the TM1638 is already in it.
+      this->writeCommand((_chipMode == ADDR_AUTO38) ? ADDR_AUTO38 : ADDR_FIXED38);
+      for(address = first; address <= last; address++) {
+        if(_dirtyRAM & ((uint16_t)1 << address)) {
+          this->writeAddress(address);                    // Write the changed address.
+        }
+      }
+    }
+    _dirtyRAM = 0;
+  }
+}
+
+// Forget what the TM1638 is known to hold, and rewrite all the LEDs and digits (+dps), the addressing mode and the display control.
+void TM1638Base::resync(void) {
+  _chipKnown = 0;
+  _chipMode = 0;
+  _chipCtrl = 0;
+  _dirtyRAM = this->chipMask();                           // Every physical display RAM address used must be rewritten.
+  _ctrlPending = true;                                    // Rewrite the brightness and display ON/OFF too.
+  this->flush();
+}
+
+// Write the pending changes - the brightness (or display ON/OFF), the changed LEDs and digits (+dps), and then
+//   read a requested key scan - stopping before the time budget (us) would be exceeded. Call it every loop, after beginUpdate(),
+//   and it carries on from where it stopped. The first unit of work is always done, even if it does not fit in the budget,
+//   so a budget shorter than a single byte still makes progress, one unit per call. Returns true once there is nothing left to do.
+bool TM1638Base::tick(uint16_t budget) {
+  STATS_CALL38(STATS_FLUSH38);
+  uint32_t start = micros(), unitStart;
+  uint8_t address, first, last, bytes;
+  uint8_t scan[4];
+  bool sent = false;                                      // Has a unit of work been done in this call?
+  if(_ctrlPending) {
+    unitStart = micros();                                 // A cmd, always the first unit.
+    _ctrlPending = false;
+    this->writeCommand(cmdDispCtrl);                      // Send the brightness, or display ON/OFF.
+    this->tickLearn(unitStart, 1);
+    sent = true;
+  }
+  this->mergeISR();                                       // Add the LED and dp changes made from an interrupt.
+  this->elide();                                          // Drop the changes that the TM1638 already holds.
+  while(this->dirtyRange(&first, &last)) {
+    bytes = (_chipMode == ADDR_AUTO38) ? 2 : 3;           // The address and the first byte, plus any addressing mode cmd.
+    // Extend the burst over the following changes while they are close together, and still fit in the time budget.
+    last = first;
+    for(address = first + 1; address < _config->chipSize && (address - last) <= 3; address++) {
+      if(_dirtyRAM & ((uint16_t)1 << address)) {
+        if(!this->tickFits(start, budget, bytes + address - first)) {
+          break;
+        }
+        last = address;
+      }
+    }
+    if(sent && !this->tickFits(start, budget, bytes + last - first)) {
+      return false;
+    }
+    unitStart = micros();
+    this->writeCommand(ADDR_AUTO38);                      // Cmd to set auto incrementing address mode.
+    this->writeBurst(first, last);
+    _dirtyRAM &= ~(uint16_t)((((uint32_t)2 << last) - 1) & ~(((uint32_t)1 << first) - 1));
+    this->tickLearn(unitStart, bytes + last - first);
+    sent = true;
+  }
+  if(_scanRequested) {
+    if(sent && !this->tickFits(start, budget, 5)) {       // The cmd and 4 bytes of key scan data.
+      return false;
+    }
+    unitStart = micros();
+    this->readKeyScan(scan);
+    _keyMatrix = this->decodeKeys(scan);
+    _keysReady = true;
+    _scanRequested = false;
+    this->tickLearn(unitStart, 5);
+  }
+  return true;
 }
 
 // Read the buttons from 4 bytes (b0 = s1, s2, s3, s4 and b4 = s5, s6, s7, s8) into a single byte.
-uint8_t TM1638::readButtons(void) {
-	uint8_t counter, buttons = 0;
-  if(_numButtons > 0) {
-    this->start();                                        // Send the start signal to the TM1638.
-    this->writeByte(READ_KEYS38);                         // Cmd to set key scan mode.
-    pinMode(_dataPin, INPUT);                             // Set the data pin to be an input.
-    for (counter = 0; counter < 4; counter++) {           // Read in 4 bytes of data.
-      buttons |= (this->readByte() << counter);           // Get the byte and shift b0 and b4 to the left as appropriate,
+uint8_t TM1638Base::readButtons(void) {
+  STATS_CALL38(STATS_BUTTONS38);
+  uint8_t counter, buttons = 0;
+  uint8_t scan[4];
+  if(_config->numButtons > 0) {
+    this->readKeyScan(scan);                              // Read in the 4 bytes of key scan data.
+    for (counter = 0; counter < 4; counter++) {
+      buttons |= ((scan[counter] & 0x11) << counter);     // Take only the K3 bits (b0 and b4), shift them to the left as appropriate,
                                                           //   and merge the button bits into a single byte.
     }
-    pinMode(_dataPin, OUTPUT);                            // Set the data pin back to an output.
-    this->stop();                                         // Send the stop signal to the TM1638.
-	}
+  }
   return buttons;
 }
 
+// Read the whole key matrix (K1-K3 x KS1-KS8) in one transaction, returning a bit for each key in the key map.
+uint32_t TM1638Base::readKeyMatrix(void) {
+  STATS_CALL38(STATS_KEYS38);
+  uint8_t scan[4];
+  this->readKeyScan(scan);                                // Read in the 4 bytes of key scan data.
+  return this->decodeKeys(scan);
+}
+
+// Set the logical to matrix key mapping used by readKeyMatrix() - nullptr for the matrix order.
+void TM1638Base::setKeyMap(uint8_t* keyMap, uint8_t numKeys) {
+  _keyMap  = keyMap;
+  _numKeys = (numKeys <= MAX_KEYS38) ? numKeys : MAX_KEYS38;
+}
+
+// Ask tick() to read the whole key matrix, when it has the time.
+void TM1638Base::requestKeyMatrix(void) {
+  _scanRequested = true;
+}
+
+// Get the key matrix read by tick(), in the same form as readKeyMatrix(). Returns false if there is no new key matrix.
+bool TM1638Base::getKeyMatrix(uint32_t* matrix) {
+  if(!_keysReady) {
+    return false;
+  }
+  *matrix = _keyMatrix;
+  _keysReady = false;
+  return true;
+}
+
 
 /***************************/
 /* Private Class Functions */
 /***************************/
 
-// Write a command to the TM1638.
-void TM1638::writeCommand(uint8_t command) {
+// Read the 4 bytes of key scan data from the TM1638, in a single transaction.
+void TM1638Base::readKeyScan(uint8_t* scan) {
+  uint8_t counter;
+  _chipMode = 0;                                          // The data command is unknown until the key scan has been read.
+  this->start();                                          // Send the start signal to the TM1638.
+  this->writeByte(READ_KEYS38);                           // Cmd to set key scan mode.
+  _transport->readMode(true);                             // Switch the data pin to be an input.
+  for(counter = 0; counter < 4; counter++) {
+    scan[counter] = this->readByte();                     // Read in 4 bytes of data.
+  }
+  _transport->readMode(false);                            // Set the data pin back to an output.
+  this->stop();                                           // Send the stop signal to the TM1638.
+  _chipMode = READ_KEYS38;
+}
+
+// Convert the 4 bytes of key scan data into the key matrix, with a bit for each key in the key map.
+uint32_t TM1638Base::decodeKeys(uint8_t* scan) {
+  uint8_t counter, line, keys[3] = {0};
+  uint32_t matrix, mapped = 0;
+  // Each byte holds K3, K2, K1 in b0-b2 for KS1, KS3, KS5, KS7 and in b4-b6 for KS2, KS4, KS6, KS8.
+  for(counter = 0; counter < 4; counter++) {
+    for(line = 0; line < 3; line++) {
+      keys[line] |= ((scan[counter] >> line) & 0x01) << (counter << 1);
+      keys[line] |= ((scan[counter] >> (line + 4)) & 0x01) << ((counter << 1) + 1);
+    }
+  }
+  // Matrix bits 0-7 = K3 x KS1-KS8, bits 8-15 = K2 x KS1-KS8, bits 16-23 = K1 x KS1-KS8.
+  matrix = keys[0] | ((uint32_t)keys[1] << 8) | ((uint32_t)keys[2] << 16);
+  if(!_keyMap) {
+    return matrix;                                        // No key map, so the keys are in matrix order.
+  }
+  for(counter = 0; counter < _numKeys; counter++) {
+    if((matrix >> _keyMap[counter]) & 0x01) {
+      mapped |= ((uint32_t)1 << counter);                 // Move the matrix bit to its logical key number.
+    }
+  }
+  return mapped;
+}
+
+// Can a number of bytes still be sent within the time budget, at the measured time per byte?
+bool TM1638Base::tickFits(uint32_t start, uint16_t budget, uint8_t bytes) {
+  return (micros() - start) + (uint32_t)bytes * _byteMicros <= budget;
+}
+
+// Update the time taken to send a byte, from a measured transfer - it rises at once, but falls slowly, so tick() stays within its budget.
+void TM1638Base::tickLearn(uint32_t start, uint8_t bytes) {
+  uint32_t perByte = (micros() - start + bytes - 1) / bytes;
+  if(perByte > 0xffff) {
+    perByte = 0xffff;
+  }
+  if(perByte < _byteMicros) {
+    perByte = ((uint32_t)_byteMicros * 7 + perByte) >> 3;
+  }
+  _byteMicros = perByte ? perByte : 1;
+}
+
+// Write a command to the TM1638, unless it is a data or display control command that the TM1638 already has.
+void TM1638Base::writeCommand(uint8_t command) {
+  if((command & 0xc0) == 0x40) {
+    if(command == _chipMode) {
+      return;                                             // The TM1638 is already in this addressing (or key scan) mode.
+    }
+    _chipMode = 0;                                        // The data command is unknown until it has been sent.
+  }
+  else if((command & 0xc0) == 0x80) {
+    if(command == _chipCtrl) {
+      return;                                             // The TM1638 already has this brightness and display ON/OFF.
+    }
+    _chipCtrl = 0;
+  }
   this->start();                                          // Send the start signal to the TM1638.
   this->writeByte(command);                               // Write the command to the TM1638.
   this->stop();                                           // Send the stop signal to the TM1638.
+  this->noteCommand(command);
+}
+
+// Record a data or display control command sent to the TM1638.
+void TM1638Base::noteCommand(uint8_t command) {
+  if((command & 0xc0) == 0x40) {
+    _chipMode = command;
+  }
+  else if((command & 0xc0) == 0x80) {
+    _chipCtrl = command;
+  }
+}
+
+// Mark the given logical digit (or its LED) as changed, using the physical display RAM address.
+void TM1638Base::markDigit(uint8_t digit, bool LED) {
+  _dirtyRAM |= ((uint16_t)1 << ((this->physDigit(digit) << 1) + LED));
+}
+
+// Merge the pending LED and dp changes made from an interrupt into the recorded values. No lock is needed - the interrupt
+//   only toggles a flag bit when a change becomes pending, and the flags are acknowledged here before the values are read,
+//   so a change made while merging is either read now, or left pending for the next merge. The values, flags and
+//   acknowledged flags are all volatile, so the compiler can not read a value before its acknowledgement is written.
+void TM1638Base::mergeISR(void) {
+  uint8_t digit, pending, values;
+  if(!((_isrLEDsFlag ^ _isrLEDsSeen) | (_isrDPsFlag ^ _isrDPsSeen))) {
+    return;                                               // Nothing has been changed from an interrupt.
+  }
+  pending = _isrLEDsFlag ^ _isrLEDsSeen;
+  _isrLEDsSeen ^= pending;                                // Acknowledge the pending LEDs...
+  values = _isrLEDs;                                      // ...and only then read their values.
+  *_LEDs = (*_LEDs & ~pending) | (values & pending);
+  for(digit = 0; digit < 8; digit++) {
+    if((pending >> digit) & 0x01) {
+      this->markDigit(digit, true);                       // Mark the LED as changed.
+    }
+  }
+  pending = _isrDPsFlag ^ _isrDPsSeen;
+  _isrDPsSeen ^= pending;                                 // Acknowledge the pending dps...
+  values = _isrDPs;                                       // ...and only then read their values.
+  for(digit = 0; digit < 8; digit++) {
+    if((pending >> digit) & 0x01) {
+      bitWrite(_registers[digit], 7, (values >> digit) & 0x01);
+      this->markDigit(digit);                             // Mark the digit decimal point as changed.
+    }
+  }
+}
+
+// Write the changed LEDs and digits to the display, unless a batch of display updates is in progress.
+void TM1638Base::refresh(void) {
+  if(!_batching) {
+    this->flush();
+  }
+}
+
+// Forget the changes that the TM1638 already holds, so they cost no bus time.
+void TM1638Base::elide(void) {
+  uint8_t address;
+  for(address = 0; address < _config->chipSize; address++) {
+    if((_dirtyRAM & _chipKnown & ((uint16_t)1 << address)) && _chipRAM[address] == this->ramByte(address)) {
+      _dirtyRAM &= ~((uint16_t)1 << address);
+    }
+  }
+}
+
+// Find the first and last changed physical display RAM addresses. Returns false if nothing has changed.
+bool TM1638Base::dirtyRange(uint8_t* first, uint8_t* last) {
+  if(!_dirtyRAM) {
+    return false;
+  }
+  for(*first = 0; !(_dirtyRAM & ((uint16_t)1 << *first)); (*first)++);
+  for(*last = 15; !(_dirtyRAM & ((uint16_t)1 << *last)); (*last)--);
+  return true;
+}
+
+// Write the recorded values for a range of physical display RAM addresses - the auto incrementing address mode must already be set.
+void TM1638Base::writeBurst(uint8_t first, uint8_t last) {
+  uint8_t address;
+  this->start();                                          // Send the start signal to the TM1638.
+  this->writeByte(STARTADDR38 + first);                   // Set the address to the first address.
+  for(address = first; address <= last; address++) {
+    _chipRAM[address] = this->ramByte(address);
+    this->writeByte(_chipRAM[address]);                   // Write every address up to, and including, the last address.
+  }
+  this->stop();                                           // Send the stop signal to the TM1638.
+  _chipKnown |= (uint16_t)((((uint32_t)2 << last) - 1) & ~(((uint32_t)1 << first) - 1));
 }
 
-// Write the given logical digit value to the correct physical digit.
-void TM1638::writeDigit(uint8_t digit, bool LED) {
+// Write the recorded value for a physical display RAM address to the TM1638.
+void TM1638Base::writeAddress(uint8_t address) {
   this->start();                                          // Send the start signal to the TM1638.
-  if(LED) {
-    // Set the address for the requested digit and write the number to the display digit.
-    this->writeByte(STARTADDR38 + (_tmDigitMap[digit] << 1) + 1);
-    this->writeByte((_allLEDs >> digit) & 0x01);
+  this->writeByte(STARTADDR38 + address);                 // Set the address for the requested digit or LED.
+  _chipRAM[address] = this->ramByte(address);
+  this->writeByte(_chipRAM[address]);                     // Write the recorded value to the display digit or LED.
+  this->stop();                                           // Send the stop signal to the TM1638.
+  _chipKnown |= ((uint16_t)1 << address);
+}
+
+// Get the recorded value for a physical display RAM address - even addresses are digits, odd addresses are LEDs.
+uint8_t TM1638Base::ramByte(uint8_t address) {
+  uint8_t digit = address >> 1;                           // With no digit map, the logical digit is the physical digit.
+  uint8_t hidden;
+  if(_config->digitMap) {
+    for(digit = 0; digit < max(_config->numDigits, _config->numLEDs); digit++) {
+      if(_config->digitMap[digit] == (address >> 1)) {    // Find the logical digit that uses this physical digit.
+        break;
+      }
+    }
+  }
+  if(digit >= max(_config->numDigits, _config->numLEDs)) {
+    return 0x00;                                          // Unused physical digits are kept blank.
+  }
+  if(address & 0x01) {
+    hidden = _animator ? _animator->_hiddenLEDs : 0x00;   // Leave out any LEDs hidden by a blink.
+    return (((*_LEDs & ~hidden) >> digit) & 0x01) | ((((_greenLEDs & ~hidden) >> digit) & 0x01) << 1);
+  }
+  if(digit >= _config->numDigits) {
+    return 0x00;                                          // A physical digit used only for an LED.
+  }
+  hidden = _animator ? _animator->_hidden[digit] : 0x00;  // Leave out any segments (+dp) hidden by a blink.
+  return _registers[digit] & ~hidden;
+}
+
+// Format a 32-bit integer as the segments of a field of digits, leftmost first - in base 2, 8, 10 or 16, with an optional
+//   decimal point and formatting flags. Only the placed decimal point is set. Returns false if the number can not be shown.
+// The digits are found without any division - binary to BCD by double dabble for base 10, and by shifting for the other bases.
+bool TM1638Base::formatNumber(uint8_t* codes, uint8_t width, int32_t number, uint8_t base, uint8_t dpPos, uint8_t flags) {
+  uint8_t values[MAX_FIELD38];                            // The number digit values, least significant first.
+  uint8_t bcd[5] = {0};                                   // Ten packed BCD digits, enough for any 32-bit number.
+  uint8_t counter, index, carry, next, shift, used, shown, offset;
+  uint32_t magnitude = number;
+  bool negative = false;
+  if(width == 0 || width > MAX_FIELD38) {
+    return false;
+  }
+  if(base != 2 && base != 8 && base != 16) {
+    base = 10;
+    if(number < 0 && !(flags & NUM_UNSIGNED38)) {
+      negative = true;
+      magnitude = -(uint32_t)number;
+    }
+  }
+  used = width - negative;                                // The digits available to the number, after any minus sign.
+  if(used == 0) {
+    return false;
+  }
+  if(base == 10) {
+    // Double dabble - shift the bits into the BCD digits, first adding 3 to any BCD digit that would overflow.
+    for(shift = 32; shift > 0 && !(magnitude & 0x80000000); shift--) {
+      magnitude <<= 1;                                    // Skip the leading zero bits.
+    }
+    for(; shift > 0; shift--) {
+      for(index = 0; index < 5; index++) {
+        if((bcd[index] & 0x0f) >= 0x05) {
+          bcd[index] += 0x03;
+        }
+        if((bcd[index] & 0xf0) >= 0x50) {
+          bcd[index] += 0x30;
+        }
+      }
+      carry = magnitude >> 31;
+      magnitude <<= 1;
+      for(index = 0; index < 5; index++) {
+        next = bcd[index] >> 7;
+        bcd[index] = (bcd[index] << 1) | carry;
+        carry = next;
+      }
+    }
+    for(index = 0; index < used; index++) {
+      values[index] = (index < 10) ? (bcd[index >> 1] >> ((index & 0x01) << 2)) & 0x0f : 0; // A 32-bit number has 10 decimal digits.
+    }
+    magnitude = 0;                                        // Note any significant digits beyond the field.
+    for(index = used; index < 10; index++) {
+      magnitude |= (bcd[index >> 1] >> ((index & 0x01) << 2)) & 0x0f;
+    }
   }
   else {
-    // Set the address for the requested digit and write the number to the display digit.
-    this->writeByte(STARTADDR38 + (_tmDigitMap[digit] << 1));
-    this->writeByte(_registers[digit]);
+    // Power of 2 bases - each digit is simply the next 1, 3 or 4 bits.
+    shift = (base == 16) ? 4 : (base == 8) ? 3 : 1;
+    for(index = 0; index < used; index++) {
+      values[index] = magnitude & (base - 1);
+      magnitude >>= shift;
+    }
   }
-  this->stop();                                           // Send the stop signal to the TM1638.
+  if(magnitude) {
+    // Clip the number at the maximum for the field.
+    for(index = 0; index < used; index++) {
+      values[index] = base - 1;
+    }
+  }
+  // Find the number of digits to show - all of them with leading zeros, otherwise down to the decimal point or the units.
+  for(shown = used; shown > 1 && values[shown - 1] == 0; shown--);
+  if(flags & NUM_ZEROS38) {
+    shown = used;
+  }
+  else if(dpPos != NO_DP38 && shown <= dpPos && dpPos < used) {
+    shown = dpPos + 1;
+  }
+  offset = (flags & NUM_LEFT38) ? (width - shown - negative) : 0;
+  // Fill the field from the rightmost digit, least significant digit first.
+  for(counter = 0; counter < width; counter++) {
+    index = width - 1 - counter;
+    if(counter >= offset && counter < offset + shown) {
+      next = this->charCode(values[counter - offset]) & 0x7f;
+    }
+    else if(negative && counter == offset + shown) {
+      next = this->charCode(0x22);                        // A minus sign (mDash), just before the most significant digit.
+    }
+    else {
+      next = 0x00;                                        // A leading (or trailing, when left aligned) blank.
+    }
+    if(dpPos != NO_DP38 && counter == dpPos + offset) {
+      next |= DP_CTRL38;                                  // Place the decimal point.
+    }
+    codes[index] = next;
+  }
+  return true;
 }
 
-// Read a byte of data from the TM1638 - using the Arduino shift function.
-uint8_t TM1638::readByte(void) {
-  uint8_t data;
-  data = shiftIn(_dataPin, _clkPin, LSBFIRST);
+// Display an ASCII string from RAM or flash, converting each character straight into the digit registers.
+// A '.' is merged into the decimal point of the digit before it, unless that digit already has one.
+void TM1638Base::displayText(uint8_t digit, const char* text, bool inFlash) {
+  STATS_CALL38(STATS_STRING38);
+  uint8_t character;
+  bool dpFree = false;                                    // Can a '.' still be merged into the previous digit?
+  while(true) {
+    character = inFlash ? pgm_read_byte(text) : *text;
+    text++;
+    if(character == '\0') {
+      break;
+    }
+    if(character == '.' && dpFree) {
+      _registers[digit - 1] |= DP_CTRL38;                 // Merge the '.' into the previous digit.
+      dpFree = false;
+      continue;
+    }
+    if(digit >= _config->numDigits) {
+      break;                                              // The rest of the string does not fit on the display.
+    }
+    _registers[digit] = (character >= 0x20 && character <= 0x7f) ? pgm_read_byte(&tmAsciiTable[character - 0x20]) : 0x00;
+    dpFree = !(_registers[digit] & DP_CTRL38);
+    this->markDigit(digit);                               // Mark the character digit as changed.
+    digit++;
+  }
+  this->refresh();                                        // Write the string to the display.
+}
+
+// Get the physical digit for a logical digit.
+uint8_t TM1638Base::physDigit(uint8_t digit) {
+  return _config->digitMap ? _config->digitMap[digit] : digit;
+}
+
+// Get a bit for each physical display RAM address used - those with a recorded value.
+uint16_t TM1638Base::chipMask(void) {
+  return (uint16_t)(((uint32_t)1 << _config->chipSize) - 1);
+}
+
+// Get a 7-segment code from the character code table in flash.
+uint8_t TM1638Base::charCode(uint8_t index) {
+  return pgm_read_byte(&tmCharTable[index]);
+}
+
+// Read a byte of data from the TM1638 - using the transport.
+uint8_t TM1638Base::readByte(void) {
+#ifdef USE_STATS38
+  uint8_t data = _transport->readByte();
+  _stats.bytes[_statsAPI]++;
+  this->traceEvent(TRACE_READ38, data);
   return data;
+#else
+  return _transport->readByte();
+#endif
 }
-// Write a byte of data to the TM1638 - using the Arduino shift function.
-void TM1638::writeByte(uint8_t data) {
-  shiftOut(_dataPin, _clkPin, LSBFIRST, data);
+// Write a byte of data to the TM1638 - using the transport.
+void TM1638Base::writeByte(uint8_t data) {
+#ifdef USE_STATS38
+  _stats.bytes[_statsAPI]++;
+  this->traceEvent(TRACE_WRITE38, data);
+#endif
+  _transport->writeByte(data);
 }
-// Send a start signal to the TM1638 - low level bit banging as per protocol.
-void TM1638::start(void) {
-  digitalWrite(_stbPin, LOW);
+// Send a start signal to the TM1638 - using the transport, once any background frame transfer has finished.
+void TM1638Base::start(void) {
+  _busInUse = true;                                       // Stop a background frame transfer from starting...
+  while(_busHeld);                                        // ...and wait for one in progress to release the bus.
+#ifdef USE_STATS38
+  _stats.strobes[_statsAPI]++;
+  this->traceEvent(TRACE_START38);
+#endif
+  _transport->start();
 }
-// Send a stop signal to the TM1638 - low level bit banging as per protocol.
-void TM1638::stop(void) {
-  digitalWrite(_stbPin, HIGH);
+// Send a stop signal to the TM1638 - using the transport.
+void TM1638Base::stop(void) {
+  _transport->stop();
+#ifdef USE_STATS38
+  this->traceEvent(TRACE_STOP38);
+#endif
+  _busInUse = false;
+}
+
+
+#ifdef USE_STATS38
+/*****************************/
+/* Instrumentation Functions */
+/*****************************/
+
+// Get the bus traffic and time statistics.
+const TM1638Stats& TM1638Base::getStats(void) {
+  return _stats;
+}
+
+// Clear the statistics and the trace.
+void TM1638Base::clearStats(void) {
+  memset(&_stats, 0x00, sizeof(_stats));
+#if TRACE_SIZE38 > 0
+  _traceNext = 0;
+  _traceCount = 0;
+#endif
+}
+
+// Write the trace of the most recent bus events, oldest first, in a compact binary format -
+//   "T38", the number of events, and then 2 bytes for each event - the library function (bits 4-7)
+//   and event type (bits 0-3), then the byte written or read. Replaying the writes into a TM1638Virtual
+//   (start, stop and writeByte) rebuilds what the display showed.
+void TM1638Base::dumpTrace(Print& out) {
+  out.write((const uint8_t*)"T38", 3);
+#if TRACE_SIZE38 > 0
+  uint8_t counter, event;
+  out.write(_traceCount);
+  event = (_traceNext + TRACE_SIZE38 - _traceCount) % TRACE_SIZE38;
+  for(counter = 0; counter < _traceCount; counter++) {
+    out.write(_trace[event], 2);
+    event = (event + 1) % TRACE_SIZE38;
+  }
+#else
+  out.write((uint8_t)0x00);
+#endif
+}
+
+// Record a bus event in the trace, along with the library function that caused it.
+void TM1638Base::traceEvent(uint8_t type, uint8_t data) {
+#if TRACE_SIZE38 > 0
+  _trace[_traceNext][0] = (_statsAPI << 4) | type;
+  _trace[_traceNext][1] = data;
+  _traceNext = (_traceNext + 1) % TRACE_SIZE38;
+  if(_traceCount < TRACE_SIZE38) {
+    _traceCount++;
+  }
+#else
+  (void)type;
+  (void)data;
+#endif
+}
+
+// Class constructor - start counting a library function call, unless it was called by another library function.
+TM1638Base::StatsScope::StatsScope(TM1638Base* display, uint8_t api) {
+  _display = display;
+  _outer = (display->_statsAPI == STATS_OTHER38);
+  if(_outer) {
+    display->_statsAPI = api;                             // Direct the bus traffic counts to this function.
+    _start = micros();
+  }
+}
+
+// Class destructor - finish counting the library function call, and add its time to the histogram.
+TM1638Base::StatsScope::~StatsScope(void) {
+  uint32_t elapsed;
+  uint8_t bin = 0;
+  if(_outer) {
+    elapsed = micros() - _start;
+    _display->_stats.calls[_display->_statsAPI]++;
+    _display->_stats.micros[_display->_statsAPI] += elapsed;
+    for(elapsed >>= 4; elapsed && bin < (STATS_BINS38 - 1); elapsed >>= 1) {
+      bin++;                                              // Each bin is twice as long as the last.
+    }
+    _display->_stats.histogram[bin]++;
+    _display->_statsAPI = STATS_OTHER38;                  // Any bus traffic is now from outside the library functions.
+  }
+}
+#endif
+
+
+/**************************/
+/* Module Chain Functions */
+/**************************/
+
+// Class constructor - with a supplied array of (already begun) modules, leftmost module first.
+TM1638Chain::TM1638Chain(TM1638Base** modules, uint8_t numModules) {
+  _modules = modules;                                     // Record the array of modules.
+  _numModules = (numModules <= MAX_MODULES38) ? numModules : MAX_MODULES38;
+}
+
+// Get the total number of digits in the chain.
+uint8_t TM1638Chain::numDigits(void) {
+  uint8_t module, digits = 0;
+  for(module = 0; module < _numModules; module++) {
+    digits += _modules[module]->_config->numDigits;
+  }
+  return digits;
+}
+
+// Turn all the TM1638 displays OFF, with a single broadcast command.
+void TM1638Chain::displayOff(void) {
+  uint8_t module;
+  for(module = 0; module < _numModules; module++) {
+    _modules[module]->cmdDispCtrl = DISP_OFF38;           // 0x80 = display OFF.
+  }
+  this->broadcast(0xff, DISP_OFF38);                      // Turn every display OFF.
+}
+
+// Clear all the LEDs and digits (+dps) in every module, with a single broadcast burst.
+void TM1638Chain::displayClear(void) {
+  uint8_t module, address;
+  for(module = 0; module < _numModules; module++) {
+    *_modules[module]->_LEDs = 0;                         // Forget every LED and digit value...
+    _modules[module]->_greenLEDs = 0;
+    memset(_modules[module]->_registers, 0x00, _modules[module]->_config->numDigits);
+    _modules[module]->_dirtyRAM = 0;                      // ...and every change, as they are all about to be cleared.
+  }
+  this->broadcast(0xff, ADDR_AUTO38);                     // Cmd to set auto incrementing address mode.
+  for(module = 0; module < _numModules; module++) {
+    _modules[module]->start();                            // Assert every strobe.
+  }
+  _modules[0]->writeByte(STARTADDR38);                    // Set the address to the first digit.
+  for(address = 0; address < 16; address++) {
+    _modules[0]->writeByte(0x00);                         // Clear every digit and LED of every module at once.
+  }
+  for(module = 0; module < _numModules; module++) {
+    _modules[module]->stop();                             // Release every strobe.
+    memset(_modules[module]->_chipRAM, 0x00, _modules[module]->_config->chipSize); // Record what every TM1638 now holds.
+    _modules[module]->_chipKnown = _modules[module]->chipMask();
+  }
+}
+
+// Set the brightness (0x00 - 0x07) and turn all the TM1638 displays ON, with a single broadcast command.
+void TM1638Chain::displayBrightness(uint8_t brightness) {
+  uint8_t module;
+  brightness &= INTENSITY_MAX38;
+  for(module = 0; module < _numModules; module++) {
+    _modules[module]->cmdDispCtrl = DISP_ON38 + brightness;
+  }
+  this->broadcast(0xff, DISP_ON38 + brightness);          // Set the brightness and turn every display ON.
+}
+
+// Test all the display LEDs and digit segments (+dps) in every module.
+void TM1638Chain::displayTest(bool dispTest) {
+  uint8_t module, address;
+  if(dispTest) {
+    // Turn ON all the LEDs, and all digit segments (+dps), with a single broadcast burst.
+    this->broadcast(0xff, ADDR_AUTO38);                   // Cmd to set auto incrementing address mode.
+    for(module = 0; module < _numModules; module++) {
+      _modules[module]->start();                          // Assert every strobe.
+    }
+    _modules[0]->writeByte(STARTADDR38);                  // Set the address to the first digit.
+    for(address = 0; address < 16; address += 2) {
+      _modules[0]->writeByte(0xff);                       // Direct write to turn all digit segments (+dps) ON.
+      _modules[0]->writeByte(LED_BOTH38);                 // Direct write to turn the LED ON, in both colours.
+      for(module = 0; module < _numModules; module++) {
+        if(_modules[module]->_config->chipSize == address + 2) {
+          _modules[module]->stop();                       // Release the strobe of a module whose used addresses end here,
+        }                                                 //   so test(false) restores everything the test turned ON.
+      }
+    }
+    for(module = 0; module < _numModules; module++) {
+      for(address = 0; address < _modules[module]->_config->chipSize; address += 2) {
+        _modules[module]->_chipRAM[address] = 0xff;       // Record what every TM1638 now holds.
+        _modules[module]->_chipRAM[address + 1] = LED_BOTH38;
+      }
+      _modules[module]->_chipKnown = _modules[module]->chipMask();
+    }
+  }
+  else {
+    // Restore all the LEDs, and all digit segments (+dps) to their previous values.
+    for(module = 0; module < _numModules; module++) {
+      _modules[module]->_dirtyRAM = _modules[module]->chipMask();
+    }
+    this->flush();
+  }
+}
+
+// Display a character in a specific digit of the chain.
+void TM1638Chain::displayChar(uint8_t digit, uint8_t number, bool raw) {
+  TM1638Base* module = this->findDigit(&digit);
+  if(module) {
+    module->displayChar(digit, number, raw);
+  }
+}
+
+// Display a number of raw segment (+dp in b7) bytes, starting at a specific digit of the chain, in one pass.
+void TM1638Chain::displayRaw(uint8_t digit, const uint8_t* segments, uint8_t length) {
+  uint8_t index;
+  for(index = 0; index < length; index++) {
+    this->setDigit(digit + index, segments[index]);
+  }
+  this->refresh();                                        // Write the digits of every module in one pass.
+}
+
+// Display an ASCII string from RAM, starting at a specific digit of the chain.
+void TM1638Chain::displayString(uint8_t digit, const char* text) {
+  this->displayText(digit, text, false);
+}
+
+// Display an ASCII string from flash, starting at a specific digit of the chain.
+void TM1638Chain::displayString(uint8_t digit, const __FlashStringHelper* text) {
+  this->displayText(digit, (const char*)text, true);
+}
+
+// Display a 32-bit integer in a field of up to 16 digits of the chain, which may span modules, in one pass.
+void TM1638Chain::displayNumber(uint8_t digit, uint8_t width, int32_t number, uint8_t base, uint8_t dpPos, uint8_t flags) {
+  uint8_t codes[MAX_FIELD38];                             // The number digit segments, leftmost first.
+  uint8_t counter;
+  if(_numModules == 0 || width == 0 || width > MAX_FIELD38 || digit + width > this->numDigits()) {
+    return;                                               // The field must fit within the chain, leftmost digit is #0.
+  }
+  if(!_modules[0]->formatNumber(codes, width, number, base, dpPos, flags)) {
+    return;
+  }
+  for(counter = 0; counter < width; counter++) {
+    if(dpPos == NO_DP38) {
+      codes[counter] |= (this->getDigit(digit + counter) & DP_CTRL38); // Keep the dp (bit 7) status.
+    }
+    this->setDigit(digit + counter, codes[counter]);
+  }
+  this->refresh();                                        // Write the number to every module in one pass.
+}
+
+// Turn ON/OFF the LED at a specific position in the chain.
+void TM1638Chain::displayLED1(uint8_t digit, bool status) {
+  TM1638Base* module = this->findDigit(&digit, true);
+  if(module) {
+    module->displayLED1(digit, status);
+  }
+}
+
+// Turn ON/OFF the decimal point in a specific digit of the chain.
+void TM1638Chain::displayDP(uint8_t digit, bool status) {
+  TM1638Base* module = this->findDigit(&digit);
+  if(module) {
+    module->displayDP(digit, status);
+  }
+}
+
+// Start a batch of display updates in every module.
+void TM1638Chain::beginUpdate(void) {
+  uint8_t module;
+  for(module = 0; module < _numModules; module++) {
+    _modules[module]->beginUpdate();
+  }
+}
+
+// Finish a batch of display updates and write all the changes to every module.
+void TM1638Chain::endUpdate(void) {
+  uint8_t module;
+  for(module = 0; module < _numModules; module++) {
+    _modules[module]->_batching = false;
+  }
+  this->flush();
+}
+
+// Write the pending display control commands, and all the changed LEDs and digits (+dps), of every module in one pass.
+void TM1638Chain::flush(void) {
+  uint8_t module, other, first, last, command, changed = 0, modes = 0;
+  // Send each pending brightness (or display ON/OFF), broadcast once to all the modules waiting for the same command.
+  for(module = 0; module < _numModules; module++) {
+    if(_modules[module]->_ctrlPending) {
+      command = _modules[module]->cmdDispCtrl;
+      modes = 0;
+      for(other = module; other < _numModules; other++) {
+        if(_modules[other]->_ctrlPending && _modules[other]->cmdDispCtrl == command) {
+          _modules[other]->_ctrlPending = false;
+          if(_modules[other]->_chipCtrl != command) {
+            modes |= (1 << other);                        // Note each module that does not already have the command.
+          }
+        }
+      }
+      if(modes) {
+        this->broadcast(modes, command);
+      }
+    }
+  }
+  modes = 0;
+  for(module = 0; module < _numModules; module++) {
+    _modules[module]->mergeISR();                         // Add the LED and dp changes made from an interrupt.
+    _modules[module]->elide();                            // Drop the changes that the TM1638 already holds.
+    if(_modules[module]->_dirtyRAM) {
+      changed |= (1 << module);                           // Note each module with changes...
+      if(_modules[module]->_chipMode != ADDR_AUTO38) {
+        modes |= (1 << module);                           // ...and each of those not already in auto incrementing address mode.
+      }
+    }
+  }
+  if(changed) {
+    if(modes) {
+      this->broadcast(modes, ADDR_AUTO38);                // One auto incrementing address mode cmd for all those modules.
+    }
+    for(module = 0; module < _numModules; module++) {
+      if(_modules[module]->dirtyRange(&first, &last)) {
+        _modules[module]->writeBurst(first, last);        // Then one burst for each changed module.
+        _modules[module]->_dirtyRAM = 0;
+      }
+    }
+  }
+}
+
+// Write a command to a set of modules at once, by asserting all their strobes - the modules share the clock and data pins.
+void TM1638Chain::broadcast(uint8_t modules, uint8_t command) {
+  uint8_t module;
+  for(module = 0; module < _numModules; module++) {
+    if(modules & (1 << module)) {
+      _modules[module]->start();                          // Assert the strobe of each selected module.
+    }
+  }
+  _modules[0]->writeByte(command);                        // Write the command to all the selected modules.
+  for(module = 0; module < _numModules; module++) {
+    if(modules & (1 << module)) {
+      _modules[module]->stop();                           // Release the strobe of each selected module.
+      _modules[module]->noteCommand(command);
+    }
+  }
+}
+
+// Display an ASCII string from RAM or flash, across the modules - a '.' is merged into the previous digit, as by TM1638::displayString().
+void TM1638Chain::displayText(uint8_t digit, const char* text, bool inFlash) {
+  uint8_t character, segments, digits = this->numDigits();
+  bool dpFree = false;                                    // Can a '.' still be merged into the previous digit?
+  while(true) {
+    character = inFlash ? pgm_read_byte(text) : *text;
+    text++;
+    if(character == '\0') {
+      break;
+    }
+    if(character == '.' && dpFree) {
+      this->setDigit(digit - 1, this->getDigit(digit - 1) | DP_CTRL38); // Merge the '.' into the previous digit.
+      dpFree = false;
+      continue;
+    }
+    if(digit >= digits) {
+      break;                                              // The rest of the string does not fit on the chain.
+    }
+    segments = (character >= 0x20 && character <= 0x7f) ? pgm_read_byte(&TM1638Base::tmAsciiTable[character - 0x20]) : 0x00;
+    dpFree = !(segments & DP_CTRL38);
+    this->setDigit(digit, segments);
+    digit++;
+  }
+  this->refresh();                                        // Write the string to every module in one pass.
+}
+
+// Record the segments (+dp) of a chain digit in its module, and mark it as changed, without writing it.
+void TM1638Chain::setDigit(uint8_t digit, uint8_t segments) {
+  TM1638Base* module = this->findDigit(&digit);
+  if(module) {
+    module->_registers[digit] = segments;
+    module->markDigit(digit);
+  }
+}
+
+// Get the recorded segments (+dp) of a chain digit, 0x00 beyond the end of the chain.
+uint8_t TM1638Chain::getDigit(uint8_t digit) {
+  TM1638Base* module = this->findDigit(&digit);
+  return module ? module->_registers[digit] : 0x00;
+}
+
+// Write the changes to every module in one pass, unless a batch of display updates is in progress.
+void TM1638Chain::refresh(void) {
+  uint8_t module;
+  for(module = 0; module < _numModules; module++) {
+    if(_modules[module]->_batching) {
+      return;
+    }
+  }
+  this->flush();
+}
+
+// Find the module holding a chain digit (or LED), converting the chain digit to the module digit.
+TM1638Base* TM1638Chain::findDigit(uint8_t* digit, bool LED) {
+  uint8_t module, count;
+  for(module = 0; module < _numModules; module++) {
+    count = LED ? _modules[module]->_config->numLEDs : _modules[module]->_config->numDigits;
+    if(*digit < count) {
+      return _modules[module];
+    }
+    *digit -= count;
+  }
+  return nullptr;                                         // The chain digit is beyond the end of the chain.
+}
+
+
+/**********************************/
+/* Asynchronous Refresh Functions */
+/**********************************/
+
+// Class constructor.
+TM1638Async::TM1638Async(TM1638Base& display) {
+  _display = &display;                                    // Record the display the frames are sent to.
+  _callback = nullptr;
+}
+
+// Start the asynchronous mode, with an optional frame completion callback (called from the interrupt).
+void TM1638Async::begin(void (*callback)(void)) {
+  _callback = callback;
+  _display->beginUpdate();                                // The display functions now only record their changes.
+}
+
+// Wait for the last frame, then finish the asynchronous mode, writing any uncommitted changes.
+void TM1638Async::end(void) {
+  while(this->busy());                                    // Wait for service() to send the remaining frames.
+  _display->endUpdate();
+}
+
+// Queue the changed LEDs and digits (+dps) as the next frame to send. Returns false if nothing has changed.
+bool TM1638Async::commit(void) {
+  uint8_t address, back, first, last;
+  bool merge;
+  _display->mergeISR();                                   // Add the LED and dp changes made from an interrupt.
+  _display->elide();                                      // Drop the changes that the TM1638 already holds.
+  if(!_display->dirtyRange(&first, &last)) {
+    return false;                                         // Nothing has changed.
+  }
+  merge = _pending;                                       // Was the previous frame still waiting to be sent?
+  _pending = false;                                       // From here service() will not swap to the back frame.
+  back = _txFrame ^ 0x01;
+  if(merge) {
+    // The previous frame was never sent, so this frame must cover its range too.
+    first = min(first, _first[back]);
+    last  = max(last, _last[back]);
+  }
+  // Copy the range into the back frame, the frame being sent is never touched.
+  for(address = first; address <= last; address++) {
+    _frames[back][address] = _display->ramByte(address);
+    _display->_chipRAM[address] = _frames[back][address]; // Record what the TM1638 will hold once the frame is sent.
+    _display->_chipKnown |= ((uint16_t)1 << address);
+  }
+  _first[back] = first;
+  _last[back]  = last;
+  _display->_dirtyRAM = 0;
+  _pending = true;                                        // Hand the back frame over to service().
+  return true;
+}
+
+// Is a frame (or display control command) being sent, or waiting to be sent?
+bool TM1638Async::busy(void) {
+  return _step != 0 || _pending || _display->_ctrlPending;
+}
+
+// Send the next byte of the current frame - call this from a timer (or SPI transfer complete) interrupt.
+void TM1638Async::service(void) {
+  TM1638Transport* transport = _display->_transport;
+  uint8_t command;
+  if(_step == 0) {
+    if(_display->_busInUse) {
+      return;                                             // The bus is in use by the sketch.
+    }
+    if(_display->_ctrlPending) {
+      // Send a batched brightness, or display ON/OFF, change first - as a single transaction.
+      _display->_ctrlPending = false;
+      command = _display->cmdDispCtrl;
+      transport->start();
+      transport->writeByte(command);
+      transport->stop();
+      _display->_chipCtrl = command;
+      return;
+    }
+    if(!_pending) {
+      return;                                             // Nothing to send.
+    }
+    _txFrame ^= 0x01;                                     // Swap to the committed frame.
+    _pending = false;
+    _display->_busHeld = true;                            // Hold the bus until the whole frame has been sent.
+    _step = (_display->_chipMode == ADDR_AUTO38) ? 2 : 1; // Skip the addressing mode cmd if the TM1638 is already in it.
+  }
+  if(_step == 1) {
+    transport->start();                                   // Cmd to set auto incrementing address mode.
+    transport->writeByte(ADDR_AUTO38);
+    transport->stop();
+    _display->_chipMode = ADDR_AUTO38;
+    _step = 2;
+  }
+  else if(_step == 2) {
+    transport->start();                                   // Set the address to the first address of the frame.
+    transport->writeByte(STARTADDR38 + _first[_txFrame]);
+    _step = 3;
+  }
+  else {
+    transport->writeByte(_frames[_txFrame][_first[_txFrame] + _step - 3]);
+    if(_first[_txFrame] + _step - 3 == _last[_txFrame]) {
+      transport->stop();                                  // That was the last address of the frame.
+      _step = 0;
+      _display->_busHeld = false;
+      if(_callback && !_pending) {
+        _callback();                                      // Signal that all the committed frames have been sent.
+      }
+    }
+    else {
+      _step++;
+    }
+  }
+}
+
+
+/****************************/
+/* Button Service Functions */
+/****************************/
+
+// Class constructor.
+TM1638Buttons::TM1638Buttons(TM1638Base& display) {
+  _display = &display;                                    // Record the display the buttons are read from.
+  this->begin();
+}
+
+// Set the scan interval, long press time and repeat interval (0 = no repeats), all in milliseconds.
+void TM1638Buttons::begin(uint16_t scanInterval, uint16_t longPress, uint16_t repeat) {
+  uint16_t scans;
+  _scanInterval = (scanInterval > 0) ? scanInterval : 1;
+  scans = longPress / _scanInterval;                      // Clip the long press between 1 and 254 scans.
+  _longScans = (scans < 1) ? 1 : (scans > 0xfe) ? 0xfe : scans;
+  scans = repeat / _scanInterval;                         // Clip the repeat interval to no more than the long press.
+  _repeatScans = (scans > _longScans) ? _longScans : scans;
+  if(repeat > 0 && _repeatScans == 0) {
+    _repeatScans = 1;                                     // Repeat as fast as the buttons are scanned.
+  }
+}
+
+// Scan the buttons (if the scan interval has passed), debounce them, and queue any new events.
+// The scan is a whole bus transaction, so this must be called from the main loop, never from an interrupt.
+void TM1638Buttons::service(void) {
+  uint8_t sample, delta, toggle, button;
+  unsigned long timeNow = millis();
+  if(timeNow - _lastScan < _scanInterval) {
+    return;                                               // Not time for the next scan yet.
+  }
+  _lastScan = timeNow;
+  sample = _display->readButtons();
+  // A 2-bit vertical counter for each button - a button only changes state after 4 scans that all disagree with it.
+  delta   = sample ^ _state;
+  _count1 = (_count1 ^ _count0) & delta;
+  _count0 = ~_count0 & delta;
+  toggle  = delta & ~(_count0 | _count1);
+  _state ^= toggle;
+  for(button = 0; button < MAX_BUTTONS38; button++) {
+    if(toggle & (1 << button)) {
+      if(_state & (1 << button)) {
+        _held[button] = 0;                                // A new press, start timing it.
+        _longDone &= ~(1 << button);
+        this->queueEvent(BTN_PRESS38 | button);
+      }
+      else {
+        this->queueEvent(BTN_RELEASE38 | button);
+      }
+    }
+    else if((_state & (1 << button)) && _held[button] != 0xff) {
+      if(++_held[button] >= _longScans) {
+        // Send the long press event, and then the repeat events.
+        this->queueEvent(((_longDone & (1 << button)) ? BTN_REPEAT38 : BTN_LONG38) | button);
+        _longDone |= (1 << button);
+        _held[button] = (_repeatScans > 0) ? (_longScans - _repeatScans) : 0xff;
+      }
+    }
+  }
+}
+
+// Get the next button event from the queue, BTN_NONE38 if the queue is empty.
+uint8_t TM1638Buttons::getEvent(void) {
+  uint8_t event;
+  if(_tail == _head) {
+    return BTN_NONE38;
+  }
+  event = _events[_tail];
+  _tail = (_tail + 1) & (BTN_QUEUE38 - 1);                // Only the consumer moves the tail.
+  return event;
+}
+
+// Get the debounced state of all the buttons.
+uint8_t TM1638Buttons::getState(void) {
+  return _state;
+}
+
+// Add a button event to the queue - the event is dropped if the queue is full.
+void TM1638Buttons::queueEvent(uint8_t event) {
+  uint8_t next = (_head + 1) & (BTN_QUEUE38 - 1);
+  if(next != _tail) {
+    _events[_head] = event;
+    _head = next;                                         // Only the producer moves the head.
+  }
+}
+
+
+/***********************/
+/* Animation Functions */
+/***********************/
+
+// Class constructor.
+TM1638Animator::TM1638Animator(TM1638Base& display) {
+  _display = &display;                                    // Record the display being animated...
+  if(!display._animator) {
+    display._animator = this;                             // ...and let it find the segments (+dps) and LEDs hidden by a blink.
+  }
+}
+
+// Class destructor.
+TM1638Animator::~TM1638Animator() {
+  if(_display->_animator == this) {
+    this->hide(0, 0);                                     // Show anything left hidden by a blink...
+    _display->_animator = nullptr;                        // ...and stop the display looking for it.
+  }
+}
+
+// Blink a set of digits, decimal points and LEDs (a bit for each), 0 for all = stop blinking.
+void TM1638Animator::blink(uint8_t digits, uint8_t dps, uint8_t LEDs, uint16_t interval) {
+  uint8_t digit;
+  if(_display->_animator != this) {
+    return;                                               // Another animator is registered with the display.
+  }
+  _blinkMask = 0;
+  for(digit = MAX_DIGITS38; digit > 0; digit--) {
+    // Build the 64-bit mask, 8 bits for each digit, the leftmost digit in the lowest byte.
+    _blinkMask = (_blinkMask << 8) | (((digits >> (digit - 1)) & 0x01) ? 0x7f : 0x00) | (((dps >> (digit - 1)) & 0x01) ? DP_CTRL38 : 0x00);
+  }
+  _blinkLEDs = LEDs;
+  _blinkInterval = (interval > 0) ? interval : 1;
+  this->hide(_blinkOff ? _blinkMask : 0, _blinkOff ? _blinkLEDs : 0);
+}
+
+// Scroll an ASCII string from RAM across the display, entering from the right, one character per interval.
+void TM1638Animator::scroll(const char* text, uint16_t interval, bool repeat) {
+  this->startText(text, false, interval, repeat);
+}
+
+// Scroll an ASCII string from flash across the display, entering from the right, one character per interval.
+void TM1638Animator::scroll(const __FlashStringHelper* text, uint16_t interval, bool repeat) {
+  this->startText(reinterpret_cast<const char*>(text), true, interval, repeat);
+}
+
+// Play a sequence of frames from flash, each 8 bytes of segments (+dp), leftmost digit first, one frame per interval.
+void TM1638Animator::play(const uint8_t* frames, uint8_t numFrames, uint16_t interval, bool repeat) {
+  _frames = frames;
+  _length = numFrames;
+  _position = 0;
+  _stepInterval = interval;
+  _repeat = repeat;
+  _mode = (numFrames > 0) ? ANIM_PLAY38 : ANIM_NONE38;
+  _lastStep = millis();
+  if(_mode) {
+    this->show(this->flashFrame());                       // Show the first frame now.
+  }
+}
+
+// Stop scrolling or playing, leaving the last frame on the display.
+void TM1638Animator::stop(void) {
+  _mode = ANIM_NONE38;
+}
+
+// Is text being scrolled, or frames being played?
+bool TM1638Animator::busy(void) {
+  return _mode != ANIM_NONE38;
+}
+
+// Blink, and show the next frame of the scrolled text or played frames, when their intervals have passed.
+void TM1638Animator::service(void) {
+  unsigned long timeNow = millis();
+  if((_blinkMask || _blinkLEDs) && timeNow - _lastBlink >= _blinkInterval) {
+    _lastBlink = timeNow;
+    _blinkOff = !_blinkOff;
+    this->hide(_blinkOff ? _blinkMask : 0, _blinkOff ? _blinkLEDs : 0);
+  }
+  if(_mode == ANIM_NONE38 || timeNow - _lastStep < _stepInterval) {
+    return;                                               // Nothing to show, or not time for the next frame yet.
+  }
+  _lastStep = timeNow;
+  _position++;
+  if(_mode == ANIM_SCROLL38) {
+    if(_position > 0 && this->textChar(_position) == '.' && this->textChar(_position - 1) != '.') {
+      _position++;                                        // Skip a '.' that was merged into the character scrolled off the left.
+    }
+    if(_position >= _length) {
+      if(!_repeat) {
+        _mode = ANIM_NONE38;                              // The text has scrolled off the display.
+      }
+      _position = -(int16_t)_display->_config->numDigits; // Start again with the text entering from the right.
+    }
+    this->show(this->textFrame());
+  }
+  else {
+    if(_position >= _length) {
+      if(!_repeat) {
+        _mode = ANIM_NONE38;                              // Leave the last frame on the display.
+        return;
+      }
+      _position = 0;
+    }
+    this->show(this->flashFrame());
+  }
+}
+
+// Start scrolling a string from RAM or flash, with the display blank and the text about to enter from the right.
+void TM1638Animator::startText(const char* text, bool inFlash, uint16_t interval, bool repeat) {
+  _text = text;
+  _inFlash = inFlash;
+  _length = inFlash ? strlen_P(text) : strlen(text);
+  _position = -(int16_t)_display->_config->numDigits;
+  _stepInterval = interval;
+  _repeat = repeat;
+  _mode = ANIM_SCROLL38;
+  _lastStep = millis();
+  this->show(this->textFrame());
+}
+
+// Get a character of the scrolled text.
+char TM1638Animator::textChar(int16_t index) {
+  return _inFlash ? pgm_read_byte(&_text[index]) : _text[index];
+}
+
+// Build the frame for the current text position - blank digits before the text starts, and a '.' merged into the character before it.
+uint64_t TM1638Animator::textFrame(void) {
+  uint8_t codes[MAX_DIGITS38] = {0};
+  uint8_t digit = 0, character;
+  int16_t index = _position;
+  uint64_t frame = 0;
+  bool dpFree = false;                                    // Can a '.' still be merged into the previous digit?
+  while(index < 0 && digit < _display->_config->numDigits) {
+    digit++;                                              // The text has not reached this digit yet.
+    index++;
+  }
+  while(index < _length) {
+    character = this->textChar(index++);
+    if(character == '.' && dpFree) {
+      codes[digit - 1] |= DP_CTRL38;                      // Merge the '.' into the previous digit.
+      dpFree = false;
+      continue;
+    }
+    if(digit >= _display->_config->numDigits) {
+      break;                                              // The rest of the text is off the right of the display.
+    }
+    codes[digit] = (character >= 0x20 && character <= 0x7f) ? pgm_read_byte(&TM1638Base::tmAsciiTable[character - 0x20]) : 0x00;
+    dpFree = !(codes[digit] & DP_CTRL38);
+    digit++;
+  }
+  for(digit = MAX_DIGITS38; digit > 0; digit--) {
+    frame = (frame << 8) | codes[digit - 1];
+  }
+  return frame;
+}
+
+// Read the current frame from flash.
+uint64_t TM1638Animator::flashFrame(void) {
+  const uint8_t* codes = _frames + (_position << 3);
+  uint8_t digit;
+  uint64_t frame = 0;
+  for(digit = MAX_DIGITS38; digit > 0; digit--) {
+    frame = (frame << 8) | pgm_read_byte(&codes[digit - 1]);
+  }
+  return frame;
+}
+
+// Write a frame to the digits, marking only the digits that have changed, 8 digits at a time.
+void TM1638Animator::show(uint64_t frame) {
+  uint64_t current = 0, changed;
+  uint8_t digit;
+  for(digit = _display->_config->numDigits; digit > 0; digit--) {
+    current = (current << 8) | _display->_registers[digit - 1];
+  }
+  changed = current ^ frame;
+  for(digit = 0; digit < _display->_config->numDigits && changed; digit++) {
+    if((uint8_t)changed) {
+      _display->_registers[digit] = (uint8_t)frame;
+      _display->markDigit(digit);                         // Mark the changed digit.
+    }
+    changed >>= 8;
+    frame >>= 8;
+  }
+  _display->refresh();                                    // Write the changed digits to the display.
+}
+
+// Hide a set of segments (+dps) and LEDs, without changing the digit and LED values - marking only the changed ones.
+void TM1638Animator::hide(uint64_t segments, uint8_t LEDs) {
+  uint8_t digit, changedLEDs = _hiddenLEDs ^ LEDs;
+  for(digit = 0; digit < _display->_config->numDigits; digit++) {
+    if(_hidden[digit] != (uint8_t)segments) {
+      _hidden[digit] = (uint8_t)segments;
+      _display->markDigit(digit);                         // Mark the changed digit.
+    }
+    segments >>= 8;
+  }
+  _hiddenLEDs = LEDs;
+  for(digit = 0; digit < _display->_config->numLEDs; digit++) {
+    if(changedLEDs & (1 << digit)) {
+      _display->markDigit(digit, true);                   // Mark the changed LED.
+    }
+  }
+  _display->refresh();                                    // Write the changes to the display.
+}
+
+
+/****************************/
+/* Virtual TM1638 Functions */
+/****************************/
+
+// Reset the virtual TM1638, as at power on.
+void TM1638Virtual::begin(void) {
+  memset(_ram, 0x00, sizeof(_ram));
+  _address  = 0;
+  _dataCmd  = ADDR_AUTO38;
+  _dispCtrl = DISP_OFF38;
+  _position = 0;
+}
+
+// Receive a start signal - the next byte is a command.
+void TM1638Virtual::start(void) {
+  if(_position) {
+    errors++;                                             // A start signal without a stop signal.
+  }
+  transactions++;
+  _position = 1;
+  _addressed = false;
+}
+
+// Receive a stop signal.
+void TM1638Virtual::stop(void) {
+  if(!_position) {
+    errors++;                                             // A stop signal without a start signal.
+  }
+  _position = 0;
+}
+
+// Receive a command or data byte.
+void TM1638Virtual::writeByte(uint8_t data) {
+  bytes++;
+  if(!_position || _reading) {
+    errors++;                                             // The TM1638 is not listening.
+    return;
+  }
+  if(_position++ == 1) {
+    // The first byte of a transaction is a command.
+    switch(data & 0xc0) {
+      case 0x40:                                          // Data command - auto/fixed address, write/read keys.
+        _dataCmd = data;
+        break;
+      case 0x80:                                          // Display control command - ON/OFF and intensity.
+        _dispCtrl = data;
+        break;
+      case 0xc0:                                          // Address command - the data bytes follow.
+        _address = data & 0x0f;
+        _addressed = true;
+        break;
+      default:
+        errors++;                                         // Not a TM1638 command.
+    }
+  }
+  else if(_addressed && (_dataCmd & 0x02) == 0) {
+    _ram[_address] = data;                                // A data byte for the display RAM.
+    if((_dataCmd & 0x04) == 0) {
+      _address = (_address + 1) & 0x0f;                   // Auto incrementing address mode.
+    }
+  }
+  else {
+    errors++;                                             // A data byte with no address, or while in key scan mode.
+  }
+}
+
+// Send the next key scan byte.
+uint8_t TM1638Virtual::readByte(void) {
+  bytes++;
+  if(!_position || !_reading || (_dataCmd & 0x02) == 0 || _position > 5) {
+    errors++;                                             // The TM1638 is not sending key scan data.
+    return 0xff;                                          // The data line is only pulled up.
+  }
+  return _keys[(_position++) - 2];
+}
+
+// Note the data line direction.
+void TM1638Virtual::readMode(bool reading) {
+  _reading = reading;
+}
+
+// Get a display RAM address value.
+uint8_t TM1638Virtual::getRAM(uint8_t address) {
+  return _ram[address & 0x0f];
+}
+
+// Is the display ON?
+bool TM1638Virtual::getDisplayOn(void) {
+  return _dispCtrl & 0x08;
+}
+
+// Get the display intensity (0x00 - 0x07).
+uint8_t TM1638Virtual::getIntensity(void) {
+  return _dispCtrl & INTENSITY_MAX38;
+}
+
+// Set the pressed keys, in readKeyMatrix() order - bits 0-7 = K3, 8-15 = K2, 16-23 = K1, each for KS1-KS8.
+void TM1638Virtual::setKeyMatrix(uint32_t matrix) {
+  uint8_t counter, line;
+  memset(_keys, 0x00, sizeof(_keys));
+  for(counter = 0; counter < 8; counter++) {
+    for(line = 0; line < 3; line++) {
+      if((matrix >> ((line << 3) + counter)) & 0x01) {
+        _keys[counter >> 1] |= 1 << (line + ((counter & 0x01) << 2));
+      }
+    }
+  }
+}
+
+// Draw the LEDs and digits (+dps) as ASCII art, 3 lines of 7-segment digits, then a line of LEDs.
+//  _
+// |_|
+// |_|.  *
+void TM1638Virtual::render(Print& out) {
+  uint8_t digit, line, segments;
+  for(line = 0; line < 4; line++) {
+    for(digit = 0; digit < 8; digit++) {
+      segments = _ram[digit << 1];
+      switch(line) {
+        case 0:
+          out.print(' ');
+          out.print((segments & 0x01) ? '_' : ' ');       // a
+          out.print("  ");
+          break;
+        case 1:
+          out.print((segments & 0x20) ? '|' : ' ');       // f
+          out.print((segments & 0x40) ? '_' : ' ');       // g
+          out.print((segments & 0x02) ? '|' : ' ');       // b
+          out.print(' ');
+          break;
+        case 2:
+          out.print((segments & 0x10) ? '|' : ' ');       // e
+          out.print((segments & 0x08) ? '_' : ' ');       // d
+          out.print((segments & 0x04) ? '|' : ' ');       // c
+          out.print((segments & 0x80) ? '.' : ' ');       // dp
+          break;
+        default:
+          out.print(' ');
+          // The LED colour - off, SEG9, SEG10 or both.
+          out.print("o*+#"[_ram[(digit << 1) + 1] & LED_BOTH38]);
+          out.print("  ");
+      }
+    }
+    out.println();
+  }
+}
+
+
+/**********************************/
+/* Bit Banged Transport Functions */
+/**********************************/
+
+// Class constructor.
+TM1638BitBang::TM1638BitBang(uint8_t stbPin, uint8_t clkPin, uint8_t dataPin) {
+  _clkPin  = clkPin;                                      // Record the TM1638 clock pin.
+  _dataPin = dataPin;                                     // Record the TM1638 data pin.
+  _stbPin  = stbPin;                                      // Record the TM1638 strobe pin.
+}
+
+// Set up the strobe, clock and data pins for output.
+void TM1638BitBang::begin(void) {
+  digitalWrite(_stbPin, HIGH);                            // The strobe idles high, so the first start() is a falling edge.
+  pinMode(_clkPin, OUTPUT);                               // Set up the clock pin for output.
+  pinMode(_dataPin, OUTPUT);                              // Set up the data pin for output.
+  pinMode(_stbPin, OUTPUT);                               // Set up the strobe pin for output.
+}
+
+// Send a start signal to the TM1638 - low level bit banging as per protocol.
+void TM1638BitBang::start(void) {
+  digitalWrite(_stbPin, LOW);
+}
+
+// Send a stop signal to the TM1638 - low level bit banging as per protocol.
+void TM1638BitBang::stop(void) {
+  digitalWrite(_stbPin, HIGH);
+}
+
+// Write a byte of data to the TM1638 - using the Arduino shift function.
+void TM1638BitBang::writeByte(uint8_t data) {
+  shiftOut(_dataPin, _clkPin, LSBFIRST, data);
+}
+
+// Read a byte of data from the TM1638 - using the Arduino shift function.
+uint8_t TM1638BitBang::readByte(void) {
+  uint8_t data;
+  data = shiftIn(_dataPin, _clkPin, LSBFIRST);
+  return data;
+}
+
+// Switch the data pin to an input (true), or back to an output (false).
+void TM1638BitBang::readMode(bool reading) {
+  pinMode(_dataPin, reading ? INPUT : OUTPUT);
 }
 
 // EOF
\ No newline at end of file
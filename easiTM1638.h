@@ -54,6 +54,47 @@
 
   // The decimal points are controlled via bit 7 of each display digit.
   #define DP_CTRL38       0x80
+  #define NO_DP38         0xff
+
+  // The LEDs are controlled via bits 0 (SEG9) and 1 (SEG10) of each odd display RAM address - a bi-colour LED uses both.
+  #define LED_OFF38       0x00
+  #define LED_RED38       0x01
+  #define LED_GREEN38     0x02
+  #define LED_BOTH38      0x03
+
+  // Number formatting flags - leading zeros (instead of blanks), left alignment, and unsigned decimal numbers.
+  #define NUM_BLANKS38    0x00
+  #define NUM_ZEROS38     0x01
+  #define NUM_LEFT38      0x02
+  #define NUM_UNSIGNED38  0x04
+
+  // The ASCII (0x20 - 0x7f) 7-segment character codes, used by displayString() and tmAscii38().
+  //        Space !     "     #     $     %     &     '     (     )     *     +     ,     -     .     /
+  #define ASCII_FONT38    0x00, 0x86, 0x22, 0x7e, 0x6d, 0xd2, 0x46, 0x20, 0x29, 0x0b, 0x21, 0x70, 0x10, 0x40, 0x80, 0x52, \
+  /*        0     1     2     3     4     5     6     7     8     9     :     ;     <     =     >     ?     */ \
+            0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x67, 0x09, 0x0d, 0x61, 0x48, 0x43, 0xd3, \
+  /*        @     A     B     C     D     E     F     G     H     I     J     K     L     M     N     O     */ \
+            0x5f, 0x77, 0x7c, 0x39, 0x5e, 0x79, 0x71, 0x3d, 0x76, 0x30, 0x1e, 0x75, 0x38, 0x15, 0x37, 0x3f, \
+  /*        P     Q     R     S     T     U     V     W     X     Y     Z     [     \     ]     ^     _     */ \
+            0x73, 0x6b, 0x33, 0x6d, 0x78, 0x3e, 0x3e, 0x2a, 0x76, 0x6e, 0x5b, 0x39, 0x64, 0x0f, 0x23, 0x08, \
+  /*        `     a     b     c     d     e     f     g     h     i     j     k     l     m     n     o     */ \
+            0x02, 0x5f, 0x7c, 0x58, 0x5e, 0x7b, 0x71, 0x6f, 0x74, 0x10, 0x0c, 0x75, 0x30, 0x14, 0x54, 0x5c, \
+  /*        p     q     r     s     t     u     v     w     x     y     z     {     |     }     ~     DEL   */ \
+            0x73, 0x67, 0x50, 0x6d, 0x78, 0x1c, 0x1c, 0x14, 0x76, 0x6e, 0x5b, 0x46, 0x30, 0x70, 0x01, 0x00
+
+  // Pick a code from a list of codes, at compile time.
+  constexpr uint8_t tmPick38(uint8_t index, uint8_t code) {
+    return (index == 0) ? code : 0x00;
+  }
+  template <typename... Codes>
+  constexpr uint8_t tmPick38(uint8_t index, uint8_t code, Codes... codes) {
+    return (index == 0) ? code : tmPick38(index - 1, codes...);
+  }
+  // Convert an ASCII character to its 7-segment character code at compile time, e.g. displayChar(0, tmAscii38('H'), true).
+  // This is meant for constant characters - use displayString() for strings.
+  constexpr uint8_t tmAscii38(char character) {
+    return ((uint8_t)character < 0x20 || (uint8_t)character > 0x7f) ? 0x00 : tmPick38((uint8_t)character - 0x20, ASCII_FONT38);
+  }
 
   // Definitions for the 7-segment display brightness.
   #define INTENSITY_MIN38 0x00
@@ -70,50 +111,657 @@
   #define MAX_DIGITS38    8
   #define DEF_BUTTONS38   8
   #define MAX_BUTTONS38   8
+  #define MAX_KEYS38      24
+  #define MAX_MODULES38   8
+  #define MAX_FIELD38     16                              // The widest number field, on a module chain.
+
+  // Button service definitions - the events hold the button number in bits 0-4, and the event type in bits 5-7.
+  #define BTN_NONE38      0x00
+  #define BTN_PRESS38     0x20
+  #define BTN_RELEASE38   0x40
+  #define BTN_LONG38      0x60
+  #define BTN_REPEAT38    0x80
+  #define BTN_TYPE38      0xe0
+  #define BTN_NUMBER38    0x1f
+  #define BTN_QUEUE38     16                              // The event queue size, must be a power of 2.
+  #define DEF_SCAN_MS38   10
+  #define DEF_LONG_MS38   1000
+  #define DEF_REPEAT_MS38 250
+
+  // Animation definitions - the default blink and scroll intervals, in milliseconds.
+  #define DEF_BLINK_MS38  500
+  #define DEF_SCROLL_MS38 300
+  #define ANIM_NONE38     0
+  #define ANIM_SCROLL38   1
+  #define ANIM_PLAY38     2
+
+  // Instrumentation - Enable this to count the bus traffic and time taken by each library function, and to trace
+  //   the most recent bus events. When it is not enabled, all the instrumentation is compiled out.
+  //#define USE_STATS38
+
+  #ifdef USE_STATS38
+    // The library functions that are counted separately - the outermost function called gets the counts.
+    #define STATS_OTHER38   0                             // Bus traffic from outside the functions below, e.g. module chains.
+    #define STATS_BEGIN38   1
+    #define STATS_OFF38     2
+    #define STATS_CLEAR38   3
+    #define STATS_BRIGHT38  4
+    #define STATS_TEST38    5
+    #define STATS_BIN838    6
+    #define STATS_CHAR38    7                             // displayChar() and displayRaw().
+    #define STATS_STRING38  8
+    #define STATS_NUMBER38  9                             // displayNumber(), and displayInt8/12/16().
+    #define STATS_LED838    10                            // displayLED8() and displayLEDs().
+    #define STATS_LED138    11                            // displayLED1() and displayLEDColour().
+    #define STATS_DP38      12
+    #define STATS_FLUSH38   13                            // flush(), endUpdate(), tick() and displayBuffer().
+    #define STATS_BUTTONS38 14
+    #define STATS_KEYS38    15
+    #define STATS_APIS38    16
+    #define STATS_BINS38    12                            // The time histogram bins, 0-15us, 16-31us, 32-63us ... 16384us+.
+    #define TRACE_SIZE38    64                            // The number of bus events kept in the trace (0 - 255), 0 for no trace.
+    // Trace event types - held in bits 0-3 of each event, with the library function in bits 4-7.
+    #define TRACE_START38   0x01
+    #define TRACE_STOP38    0x02
+    #define TRACE_WRITE38   0x03
+    #define TRACE_READ38    0x04
+
+    // The bus traffic and time statistics, for each library function.
+    struct TM1638Stats {
+      uint32_t calls[STATS_APIS38];                       // The number of calls.
+      uint32_t strobes[STATS_APIS38];                     // The number of strobe transactions.
+      uint32_t bytes[STATS_APIS38];                       // The number of bytes written or read.
+      uint32_t micros[STATS_APIS38];                      // The total time taken, in microseconds.
+      uint16_t histogram[STATS_BINS38];                   // The number of calls, of any function, by time taken.
+    };
+  #endif
+
+  // Count the bus traffic and time taken by a library function, when the instrumentation is enabled.
+  #ifdef USE_STATS38
+    #define STATS_CALL38(api) StatsScope statsScope(this, api)
+  #else
+    #define STATS_CALL38(api)
+  #endif
 
-  class TM1638 {
+  // The serial transport used to talk to a TM1638 - the strobe, clock and (half-duplex, LSB first) data lines.
+  class TM1638Transport {
+    public:
+      virtual void begin(void) = 0;                       // Set up the transport pins (or peripheral).
+      virtual void start(void) = 0;                       // Send a start signal to the TM1638.
+      virtual void stop(void) = 0;                        // Send a stop signal to the TM1638.
+      virtual void writeByte(uint8_t) = 0;                // Write a byte of data to the TM1638.
+      virtual uint8_t readByte(void) = 0;                 // Read a byte of data from the TM1638.
+      virtual void readMode(bool) = 0;                    // Switch the data line to the key scan read phase (true), or back (false).
+  };
+
+  // The default transport - bit banged using the Arduino shiftIn/shiftOut/digitalWrite functions.
+  class TM1638BitBang : public TM1638Transport {
+    public:
+      // TM1638BitBang Class instantiation.
+      TM1638BitBang(uint8_t = DEF_TM_STB38, uint8_t = DEF_TM_CLK38, uint8_t = DEF_TM_DIN38);
+      void begin(void) override;                          // Set up the strobe, clock and data pins for output.
+      void start(void) override;                          // Send a start signal to the TM1638.
+      void stop(void) override;                           // Send a stop signal to the TM1638.
+      void writeByte(uint8_t) override;                   // Write a byte of data to the TM1638.
+      uint8_t readByte(void) override;                    // Read a byte of data from the TM1638.
+      void readMode(bool) override;                       // Switch the data pin to an input (true), or back to an output (false).
+    protected:
+      uint8_t _clkPin;                                    // The current TM1638 clock pin.
+      uint8_t _dataPin;                                   // The current TM1638 data pin.
+      uint8_t _stbPin;                                    // The current TM1638 strobe pin.
+  };
+
+  // The display size and digit map - fixed at compile time (and shared by every instance) for TM1638T,
+  //   and set by begin() for TM1638 and TM1638Fast.
+  struct TM1638Config {
+    uint8_t numDigits;                                    // The number of TM1638 module digits.
+    uint8_t numLEDs;                                      // The number of TM1638 module LEDs.
+    uint8_t numButtons;                                   // The number of TM1638 module buttons.
+    uint8_t chipSize;                                     // The number of physical display RAM addresses used.
+    const uint8_t* digitMap;                              // A pointer to the physical to logical digit mapping, nullptr for the default.
+  };
+
+  class TM1638Animator;
+
+  // The display functions shared by TM1638, TM1638Fast and TM1638T. It holds no transport, display size, digit values
+  //   or display RAM values of its own - each derived class supplies them, sized to suit, so a smaller display takes less RAM.
+  class TM1638Base {
+    friend class TM1638Async;
+    friend class TM1638Chain;
+    friend class TM1638Animator;
+    template <uint8_t, uint8_t, uint8_t, const uint8_t*> friend class TM1638T;
     public:
-      // TM1638 Class instantiation.
-      TM1638(uint8_t = DEF_TM_STB38, uint8_t = DEF_TM_CLK38, uint8_t = DEF_TM_DIN38);
       uint8_t cmdDispCtrl;                                // The current display control command.
-      uint8_t charTableSize;                              // The size of the defined character code table.
-      static uint8_t tmCharTable[];                       // This is a class variable, shared across all class instances.
-      // Set up the display and initialise it with defaults values - with the default digit map.
-      void begin(uint8_t = DEF_BUTTONS38, uint8_t = DEF_LEDS38, uint8_t = DEF_DIGITS38, uint8_t = INTENSITY_TYP38);
-      // Set up the display and initialise it with defaults values - with a supplied digit map.
-      void begin(uint8_t*, uint8_t = DEF_BUTTONS38, uint8_t = DEF_LEDS38, uint8_t = DEF_DIGITS38, uint8_t = INTENSITY_TYP38);
+      static const uint8_t charTableSize;                 // The size of the defined character code table.
       void displayOff(void);                              // Turn the TM1638 display OFF.
       void displayClear(void);                            // Clear all the LEDs and digits (+dps) in the display.
       void displayBrightness(uint8_t = INTENSITY_TYP38);  // Set the brightness (0x00 - 0x07) and turn the TM1638 display ON.
       void displayTest(bool = false);                     // Test the display - all the display LEDs and digit segments (+dps).
       void displayBin8(uint8_t, bool = false);            // Display a binary integer between 0b00000000 - 0b11111111, starting at digit 0 for the LSB or MSB.
       void displayChar(uint8_t, uint8_t, bool = false);   // Display a character in a specific digit.
+      void displayRaw(uint8_t, const uint8_t*, uint8_t);  // Display a number of raw segment (+dp) bytes, starting at a specific digit.
+      void displayString(uint8_t, const char*);           // Display an ASCII string from RAM, starting at a specific digit.
+      void displayString(uint8_t, const __FlashStringHelper*); // Display an ASCII string from flash, starting at a specific digit.
       void displayInt8(uint8_t, uint8_t, bool = true);    // Display a decimal integer between 0 - 99, or a hex integer between 0x00 - 0xff, starting at a specific digit.
       void displayInt12(uint8_t, uint16_t, bool = true);  // Display a decimal integer between 0 - 999, or a hex integer between 0x000 - 0xfff, starting at a specific digit.
       void displayInt16(uint8_t, uint16_t, bool = true);  // Display a decimal integer between 0 - 9999, or a hex integer between 0x0000 - 0xffff, starting at a specific digit.
+      // Display a 32-bit integer in a field of digits, in base 2, 8, 10 or 16, with an optional decimal point and formatting flags.
+      void displayNumber(uint8_t, uint8_t, int32_t, uint8_t = 10, uint8_t = NO_DP38, uint8_t = NUM_BLANKS38);
       void displayLED8(uint8_t, bool = false);            // Display a binary integer between 0b00000000 - 0b11111111 on the LEDs, starting at LED 0 for the LSB or MSB.
       void displayLED1(uint8_t, bool = OFF);              // Turn ON/OFF the LED at a specific position.
+      void displayLEDColour(uint8_t, uint8_t);            // Set the colour of the (bi-colour) LED at a specific position.
+      void displayLEDs(uint16_t);                         // Set the colour of every (bi-colour) LED, the SEG9 LEDs in the low byte and the SEG10 LEDs in the high byte.
       void displayDP(uint8_t, bool = OFF);                // Turn ON/OFF the decimal point in a specific digit.
+      void displayLED1FromISR(uint8_t, bool = OFF);       // Turn ON/OFF an LED from an interrupt, at the next transaction boundary.
+      void displayDPFromISR(uint8_t, bool = OFF);         // Turn ON/OFF a decimal point from an interrupt, at the next transaction boundary.
+      void attachBuffer(uint8_t*, uint8_t* = nullptr);    // Use a caller owned buffer for the digit values, and optionally the LED values.
+      void displayBuffer(void);                           // Write the changes the caller has made to the attached buffer to the display.
+      void beginUpdate(void);                             // Start a batch of display updates, only recording the changes.
+      void endUpdate(void);                               // Finish a batch of display updates and write all the changes to the display.
+      void flush(void);                                   // Write all the changed LEDs and digits (+dps) to the display.
+      void resync(void);                                  // Forget what the TM1638 is known to hold, and rewrite all of it.
+      bool tick(uint16_t);                                // Write the pending changes, and read a requested key scan, within a time budget (us).
       uint8_t readButtons(void);                          // Read all the buttons into a single byte.
+      uint32_t readKeyMatrix(void);                       // Read the whole (up to 24) key matrix in one transaction.
+      void setKeyMap(uint8_t*, uint8_t = MAX_KEYS38);     // Set the logical to matrix key mapping used by readKeyMatrix().
+      void requestKeyMatrix(void);                        // Ask tick() to read the whole key matrix.
+      bool getKeyMatrix(uint32_t*);                       // Get the key matrix read by tick(), if there is a new one.
+    #ifdef USE_STATS38
+      const TM1638Stats& getStats(void);                  // Get the bus traffic and time statistics.
+      void clearStats(void);                              // Clear the statistics and the trace.
+      void dumpTrace(Print&);                             // Write the trace of the most recent bus events, in a compact binary format.
+    #endif
+    protected:
+      // TM1638Base Class instantiation - with the derived class's transport, display size, and storage (the display RAM values, then the digit values).
+      TM1638Base(TM1638Transport&, const TM1638Config*, uint8_t*, uint8_t);
+      // Check and record a display size and digit map set at runtime, then set up the display.
+      void configure(TM1638Config*, uint8_t*, uint8_t, uint8_t, uint8_t, uint8_t);
+      void initialise(uint8_t);                           // Set up the display and initialise it with default values.
     private:
-      uint8_t _clkPin;                                    // The current TM1638 clock pin.
-      uint8_t _dataPin;                                   // The current TM1638 data pin.
-      uint8_t _stbPin;                                    // The current TM1638 strobe pin.
-      uint8_t _numLEDs;                                   // The number of TM1638 module LEDs.
-      uint8_t _numDigits;                                 // The number of TM1638 module digits.
-      uint8_t _numButtons;                                // The number of TM1638 module buttons.
-      uint8_t _brightness;                                // The current TM1638 display brightness.
+      static const uint8_t tmCharTable[];                 // This is a class variable in flash, shared across all class instances - read it with charCode().
+      static const uint8_t tmAsciiTable[];                // This is a class variable in flash, shared across all class instances - read it with pgm_read_byte().
+    #ifdef USE_STATS38
+      // Counts the time taken by the outermost library function call, and directs the bus traffic counts to it.
+      class StatsScope {
+        public:
+          StatsScope(TM1638Base*, uint8_t);
+          ~StatsScope(void);
+        private:
+          TM1638Base* _display;                           // A pointer to the display being counted.
+          uint32_t _start;                                // The time the call started.
+          bool _outer;                                    // Is this the outermost library function call?
+      };
+      TM1638Stats _stats = {};                            // The bus traffic and time statistics.
+      uint8_t _statsAPI = STATS_OTHER38;                  // The library function currently being counted.
+      #if TRACE_SIZE38 > 0
+      uint8_t _trace[TRACE_SIZE38][2];                    // The ring buffer of bus events, each an event type and a byte of data.
+      uint8_t _traceNext = 0;                             // The next trace event to write.
+      uint8_t _traceCount = 0;                            // The number of trace events recorded.
+      #endif
+      void traceEvent(uint8_t, uint8_t = 0);              // Record a bus event in the trace.
+    #endif
+      TM1638Transport* _transport;                        // A pointer to the transport in use.
+      const TM1638Config* _config;                        // A pointer to the display size and digit map in use.
       uint8_t _allLEDs = 0;                               // A byte used to hold the TM1638 module LED values.
-      uint8_t _registers[MAX_DIGITS38] = {0};             // An array used to hold the TM1638 display digit values.
-      uint8_t* _tmDigitMap;                               // A pointer to the physical to logical digit mapping.
-      static uint8_t tmDigitMapDefault[];                 // An array to hold the default physical to logical digit mapping.
-      void writeCommand(uint8_t);                         // Write a command to the TM1638.
-      void writeDigit(uint8_t, bool = false);             // Write the given logical digit value to the correct physical digit.
+      uint8_t* _LEDs = &_allLEDs;                         // A pointer to the LED values in use, the caller's or our own.
+      uint8_t _greenLEDs = 0;                             // A byte used to hold the second (SEG10) colour of the bi-colour LED values.
+      TM1638Animator* _animator = nullptr;                // A pointer to the animator hiding segments (+dps) and LEDs in a blink, nullptr for none.
+      uint8_t* _registers;                                // A pointer to the digit values in use, the caller's or our own.
+      uint16_t _dirtyRAM = 0;                             // A bit for each physical display RAM address that has changed.
+      uint8_t* _chipRAM;                                  // A pointer to the values last written to each physical display RAM address,
+                                                          //   followed by our own digit values.
+      uint16_t _chipKnown = 0;                            // A bit for each physical display RAM address whose value is known.
+      volatile uint8_t _chipMode = 0;                     // The last data command sent, 0 = unknown.
+      volatile uint8_t _chipCtrl = 0;                     // The last display control command sent, 0 = unknown.
+      volatile bool _ctrlPending = false;                 // True while a display control command is waiting to be sent.
+      bool _scanRequested = false;                        // True while a key scan is waiting to be read by tick().
+      bool _keysReady = false;                            // True when tick() has read a new key matrix.
+      uint32_t _keyMatrix = 0;                            // The key matrix read by tick().
+      uint16_t _byteMicros = 0;                           // The measured time taken to send a byte, used by tick(), 0 = not measured.
+      bool _batching = false;                             // True while a batch of display updates is in progress.
+      volatile bool _busHeld = false;                     // True while a background frame transfer holds the bus.
+      volatile bool _busInUse = false;                    // True while a foreground transaction is using the bus.
+      volatile uint8_t _isrLEDs = 0;                      // The LED values set from an interrupt, only changed by displayLED1FromISR().
+      volatile uint8_t _isrLEDsFlag = 0;                  // A bit toggled when an LED change from an interrupt becomes pending.
+      volatile uint8_t _isrLEDsSeen = 0;                  // The LED change flags already merged, only changed by mergeISR().
+      volatile uint8_t _isrDPs = 0;                       // The dp values set from an interrupt, only changed by displayDPFromISR().
+      volatile uint8_t _isrDPsFlag = 0;                   // A bit toggled when a dp change from an interrupt becomes pending.
+      volatile uint8_t _isrDPsSeen = 0;                   // The dp change flags already merged, only changed by mergeISR().
+      uint8_t* _keyMap = nullptr;                         // A pointer to the logical to matrix key mapping, nullptr for the matrix order.
+      uint8_t _numKeys = MAX_KEYS38;                      // The number of keys in the key mapping.
+      void readKeyScan(uint8_t*);                         // Read the 4 bytes of key scan data from the TM1638.
+      uint32_t decodeKeys(uint8_t*);                      // Convert the 4 bytes of key scan data into the (mapped) key matrix.
+      bool tickFits(uint32_t, uint16_t, uint8_t);         // Can a number of bytes still be sent within the time budget?
+      void tickLearn(uint32_t, uint8_t);                  // Update the time taken to send a byte, from a measurement.
+      void writeCommand(uint8_t);                         // Write a command to the TM1638, unless it already has it.
+      void noteCommand(uint8_t);                          // Record a data or display control command sent to the TM1638.
+      void markDigit(uint8_t, bool = false);              // Mark the given logical digit (or its LED) as changed.
+      void mergeISR(void);                                // Merge the pending LED and dp changes made from an interrupt.
+      void refresh(void);                                 // Write the changes to the display, unless batching display updates.
+      void elide(void);                                   // Forget the changes that the TM1638 already holds.
+      bool dirtyRange(uint8_t*, uint8_t*);                // Find the first and last changed physical display RAM addresses.
+      void writeBurst(uint8_t, uint8_t);                  // Write the recorded values for a range of physical display RAM addresses.
+      void writeAddress(uint8_t);                         // Write the recorded value for a physical display RAM address.
+      uint8_t ramByte(uint8_t);                           // Get the recorded value for a physical display RAM address.
+      uint8_t physDigit(uint8_t);                         // Get the physical digit for a logical digit.
+      uint16_t chipMask(void);                            // Get a bit for each physical display RAM address used.
+      uint8_t charCode(uint8_t);                          // Get a 7-segment code from the character code table in flash.
+      bool formatNumber(uint8_t*, uint8_t, int32_t, uint8_t, uint8_t, uint8_t); // Format a 32-bit integer as the segments of a field of digits.
+      void displayText(uint8_t, const char*, bool);       // Display an ASCII string from RAM or flash.
       uint8_t readByte(void);                             // Read a byte of data from the TM1638.
       void writeByte(uint8_t);                            // Write a byte of data to the TM1638.
       void start(void);                                   // Send a start signal to the TM1638.
       void stop(void);                                    // Send a stop signal to the TM1638.
   };
+
+  // A TM1638 display, with storage for up to 8 digits - the display size is chosen at runtime by begin().
+  class TM1638 : public TM1638Base {
+    public:
+      // TM1638 Class instantiation.
+      TM1638(uint8_t = DEF_TM_STB38, uint8_t = DEF_TM_CLK38, uint8_t = DEF_TM_DIN38);
+      // TM1638 Class instantiation - with a supplied transport.
+      TM1638(TM1638Transport&);
+      // Set up the display and initialise it with defaults values - with the default digit map.
+      void begin(uint8_t = DEF_BUTTONS38, uint8_t = DEF_LEDS38, uint8_t = DEF_DIGITS38, uint8_t = INTENSITY_TYP38);
+      // Set up the display and initialise it with defaults values - with a supplied digit map.
+      void begin(uint8_t*, uint8_t = DEF_BUTTONS38, uint8_t = DEF_LEDS38, uint8_t = DEF_DIGITS38, uint8_t = INTENSITY_TYP38);
+    private:
+      TM1638BitBang _bitBang;                             // The default transport, used when no transport is supplied.
+      TM1638Config _size = {DEF_DIGITS38, DEF_LEDS38, DEF_BUTTONS38, 16, nullptr}; // The display size set by begin().
+      uint8_t _storage[16 + MAX_DIGITS38] = {0};          // The 16 display RAM values last written, then the 8 digit values.
+  };
+
+  // A non-blocking display refresh engine - frames are committed from the display's recorded changes,
+  //   and then sent to the TM1638 in the background, one byte at a time, by calling service() from an interrupt.
+  class TM1638Async {
+    public:
+      // TM1638Async Class instantiation.
+      TM1638Async(TM1638Base&);
+      void begin(void (*)(void) = nullptr);               // Start the asynchronous mode, with an optional frame completion callback.
+      void end(void);                                     // Wait for the last frame, then finish the asynchronous mode.
+      bool commit(void);                                  // Queue the changed LEDs and digits (+dps) as the next frame to send.
+      bool busy(void);                                    // Is a frame being sent, or waiting to be sent?
+      void service(void);                                 // Send the next byte of the current frame - call this from an interrupt.
+    private:
+      TM1638Base* _display;                               // A pointer to the display the frames are sent to.
+      void (*_callback)(void);                            // A pointer to the frame completion callback.
+      uint8_t _frames[2][16];                             // The two frame buffers, each holding the 16 display RAM addresses.
+      uint8_t _first[2];                                  // The first display RAM address to send, for each frame.
+      uint8_t _last[2];                                   // The last display RAM address to send, for each frame.
+      volatile uint8_t _txFrame = 0;                      // The frame being sent, only changed by service().
+      volatile uint8_t _step = 0;                         // The next step of the frame transfer, 0 = idle.
+      volatile bool _pending = false;                     // True while the other frame is waiting to be sent.
+  };
+
+  // A virtual TM1638 - a transport that decodes the bus traffic exactly as the TM1638 would, into a 16 byte display RAM,
+  //   the display control settings and scripted key scan data. Used to check, and draw, what a real TM1638 would show.
+  class TM1638Virtual : public TM1638Transport {
+    public:
+      uint32_t transactions = 0;                          // The number of strobe transactions.
+      uint32_t bytes = 0;                                 // The number of bytes written or read.
+      uint16_t errors = 0;                                // The number of protocol errors, bytes the TM1638 would ignore or misread.
+      void begin(void) override;                          // Reset the virtual TM1638, as at power on.
+      void start(void) override;                          // Receive a start signal.
+      void stop(void) override;                           // Receive a stop signal.
+      void writeByte(uint8_t) override;                   // Receive a command or data byte.
+      uint8_t readByte(void) override;                    // Send the next key scan byte.
+      void readMode(bool) override;                       // Note the data line direction.
+      uint8_t getRAM(uint8_t);                            // Get a display RAM address value.
+      bool getDisplayOn(void);                            // Is the display ON?
+      uint8_t getIntensity(void);                         // Get the display intensity (0x00 - 0x07).
+      void setKeyMatrix(uint32_t);                        // Set the pressed keys, in readKeyMatrix() order.
+      void render(Print&);                                // Draw the LEDs and digits (+dps) as ASCII art.
+    private:
+      uint8_t _ram[16] = {0};                             // The display RAM.
+      uint8_t _keys[4] = {0};                             // The key scan data.
+      uint8_t _address = 0;                               // The current display RAM address.
+      uint8_t _dataCmd = ADDR_AUTO38;                     // The last data command.
+      uint8_t _dispCtrl = DISP_OFF38;                     // The last display control command.
+      uint8_t _position = 0;                              // The byte position within the current transaction, 0 = not started.
+      bool _addressed = false;                            // Has an address been set in this transaction?
+      bool _reading = false;                              // Is the data line switched to the key scan read phase?
+  };
+
+  // A chain of TM1638 modules sharing the clock and data pins, each with its own strobe pin, used as one logical display.
+  // Commands that are the same for every module are broadcast, by asserting all the strobes at once.
+  class TM1638Chain {
+    public:
+      // TM1638Chain Class instantiation - with a supplied array of (already begun) modules, leftmost module first.
+      TM1638Chain(TM1638Base**, uint8_t);
+      uint8_t numDigits(void);                            // Get the total number of digits in the chain.
+      void displayOff(void);                              // Turn all the TM1638 displays OFF.
+      void displayClear(void);                            // Clear all the LEDs and digits (+dps) in every module.
+      void displayBrightness(uint8_t = INTENSITY_TYP38);  // Set the brightness (0x00 - 0x07) and turn all the TM1638 displays ON.
+      void displayTest(bool = false);                     // Test all the display LEDs and digit segments (+dps) in every module.
+      void displayChar(uint8_t, uint8_t, bool = false);   // Display a character in a specific digit of the chain.
+      void displayRaw(uint8_t, const uint8_t*, uint8_t);  // Display a number of raw segment (+dp) bytes, starting at a specific digit of the chain.
+      void displayString(uint8_t, const char*);           // Display an ASCII string from RAM, starting at a specific digit of the chain.
+      void displayString(uint8_t, const __FlashStringHelper*); // Display an ASCII string from flash, starting at a specific digit of the chain.
+      // Display a 32-bit integer in a field of up to 16 digits of the chain, which may span modules.
+      void displayNumber(uint8_t, uint8_t, int32_t, uint8_t = 10, uint8_t = NO_DP38, uint8_t = NUM_BLANKS38);
+      void displayLED1(uint8_t, bool = OFF);              // Turn ON/OFF the LED at a specific position in the chain.
+      void displayDP(uint8_t, bool = OFF);                // Turn ON/OFF the decimal point in a specific digit of the chain.
+      void beginUpdate(void);                             // Start a batch of display updates in every module.
+      void endUpdate(void);                               // Finish a batch of display updates and write all the changes to every module.
+      void flush(void);                                   // Write all the changed LEDs and digits (+dps) of every module in one pass.
+    private:
+      TM1638Base** _modules;                              // A pointer to the array of modules.
+      uint8_t _numModules;                                // The number of modules in the chain.
+      void broadcast(uint8_t, uint8_t);                   // Write a command to a set of modules at once.
+      void displayText(uint8_t, const char*, bool);       // Display an ASCII string from RAM or flash, across the modules.
+      void setDigit(uint8_t, uint8_t);                    // Record the segments (+dp) of a chain digit, and mark it as changed.
+      uint8_t getDigit(uint8_t);                          // Get the recorded segments (+dp) of a chain digit.
+      void refresh(void);                                 // Write the changes to every module, unless batching display updates.
+      TM1638Base* findDigit(uint8_t*, bool = false);      // Find the module holding a chain digit (or LED).
+  };
+
+  // A button service - the buttons are scanned at a fixed interval, debounced, and turned into queued events.
+  class TM1638Buttons {
+    public:
+      // TM1638Buttons Class instantiation.
+      TM1638Buttons(TM1638Base&);
+      // Set the scan interval, long press time and repeat interval (0 = no repeats), all in milliseconds.
+      void begin(uint16_t = DEF_SCAN_MS38, uint16_t = DEF_LONG_MS38, uint16_t = DEF_REPEAT_MS38);
+      void service(void);                                 // Scan the buttons (if the scan interval has passed) and queue any new events - main loop only.
+      uint8_t getEvent(void);                             // Get the next button event from the queue, BTN_NONE38 if the queue is empty.
+      uint8_t getState(void);                             // Get the debounced state of all the buttons.
+    private:
+      TM1638Base* _display;                               // A pointer to the display the buttons are read from.
+      unsigned long _lastScan = 0;                        // The time of the last button scan.
+      uint16_t _scanInterval;                             // The time between button scans, in milliseconds.
+      uint8_t _longScans;                                 // The number of scans for a long press.
+      uint8_t _repeatScans;                               // The number of scans between repeats, 0 = no repeats.
+      uint8_t _state = 0;                                 // The debounced button states.
+      uint8_t _count0 = 0;                                // The vertical counter bit 0, for each button.
+      uint8_t _count1 = 0;                                // The vertical counter bit 1, for each button.
+      uint8_t _longDone = 0;                              // A bit for each button that has already sent its long press event.
+      uint8_t _held[MAX_BUTTONS38];                       // The number of scans each button has been held for.
+      uint8_t _events[BTN_QUEUE38];                       // The button event queue.
+      volatile uint8_t _head = 0;                         // The next event queue slot to write, only changed by service().
+      volatile uint8_t _tail = 0;                         // The next event queue slot to read, only changed by getEvent().
+      void queueEvent(uint8_t);                           // Add a button event to the queue.
+  };
+
+  // A non-blocking animation engine - it blinks digits, decimal points and LEDs, scrolls text longer than the display,
+  //   and plays sequences of 8-digit frames from flash, all scheduled by millis(). Call service() every loop.
+  class TM1638Animator {
+    friend class TM1638Base;
+    public:
+      // TM1638Animator Class instantiation.
+      TM1638Animator(TM1638Base&);
+      ~TM1638Animator();
+      // Blink a set of digits, decimal points and LEDs (a bit for each), 0 for all = stop blinking.
+      void blink(uint8_t, uint8_t = 0x00, uint8_t = 0x00, uint16_t = DEF_BLINK_MS38);
+      void scroll(const char*, uint16_t = DEF_SCROLL_MS38, bool = true); // Scroll an ASCII string from RAM across the display.
+      void scroll(const __FlashStringHelper*, uint16_t = DEF_SCROLL_MS38, bool = true); // Scroll an ASCII string from flash across the display.
+      void play(const uint8_t*, uint8_t, uint16_t, bool = true); // Play a sequence of 8-digit frames from flash.
+      void stop(void);                                    // Stop scrolling or playing, leaving the last frame on the display.
+      bool busy(void);                                    // Is text being scrolled, or frames being played?
+      void service(void);                                 // Blink, and show the next frame, when their intervals have passed.
+    private:
+      TM1638Base* _display;                               // A pointer to the display being animated.
+      uint64_t _blinkMask = 0;                            // The segments (+dps) hidden in the OFF phase of a blink, 8 bits for each digit.
+      uint8_t _hidden[MAX_DIGITS38] = {0};                // The segments (+dp) of each digit currently hidden, without changing the digit values.
+      uint8_t _hiddenLEDs = 0;                            // The LEDs currently hidden, without changing the LED values.
+      uint8_t _blinkLEDs = 0;                             // The LEDs hidden in the OFF phase of a blink.
+      bool _blinkOff = false;                             // True during the OFF phase of a blink.
+      uint16_t _blinkInterval = DEF_BLINK_MS38;           // The time between blink phases, in milliseconds.
+      unsigned long _lastBlink = 0;                       // The time of the last blink phase change.
+      uint8_t _mode = ANIM_NONE38;                        // Scrolling text, playing frames, or neither.
+      const char* _text;                                  // A pointer to the text being scrolled.
+      const uint8_t* _frames;                             // A pointer to the frames being played, in flash.
+      bool _inFlash;                                      // Is the scrolled text in flash?
+      bool _repeat;                                       // Start again at the end of the text or frames?
+      int16_t _position;                                  // The text position of the leftmost digit, or the frame being played.
+      int16_t _length;                                    // The length of the text, or the number of frames.
+      uint16_t _stepInterval;                             // The time between frames, in milliseconds.
+      unsigned long _lastStep = 0;                        // The time of the last frame.
+      void startText(const char*, bool, uint16_t, bool);  // Start scrolling a string from RAM or flash.
+      char textChar(int16_t);                             // Get a character of the scrolled text.
+      uint64_t textFrame(void);                           // Build the frame for the current text position.
+      uint64_t flashFrame(void);                          // Read the current frame from flash.
+      void show(uint64_t);                                // Write a frame to the digits, marking only the changed digits.
+      void hide(uint64_t, uint8_t);                       // Hide a set of segments (+dps) and LEDs, marking only the changed ones.
+  };
+
+  #if defined(__AVR__)
+    // A transport with its pins fixed at compile time, driven by direct port I/O instead of shiftIn/shiftOut/digitalWrite.
+    // The port registers and bit masks are looked up once, rather than on every bit, and each clock phase
+    //   is padded with a couple of cycles to keep the clock pulse width above the 400ns datasheet minimum.
+    template <uint8_t STB, uint8_t CLK, uint8_t DIN>
+    class TM1638PortIO : public TM1638Transport {
+      public:
+        // TM1638PortIO Class instantiation.
+        TM1638PortIO() {
+          _stbOut  = portOutputRegister(digitalPinToPort(STB));
+          _stbMask = digitalPinToBitMask(STB);
+          _clkOut  = portOutputRegister(digitalPinToPort(CLK));
+          _clkMask = digitalPinToBitMask(CLK);
+          _dinOut  = portOutputRegister(digitalPinToPort(DIN));
+          _dinIn   = portInputRegister(digitalPinToPort(DIN));
+          _dinMode = portModeRegister(digitalPinToPort(DIN));
+          _dinMask = digitalPinToBitMask(DIN);
+        }
+        // Set up the strobe, clock and data pins for output.
+        void begin(void) override {
+          digitalWrite(STB, HIGH);                        // The strobe idles high, so the first start() is a falling edge.
+          pinMode(CLK, OUTPUT);
+          pinMode(DIN, OUTPUT);
+          pinMode(STB, OUTPUT);
+        }
+        // Send a start signal to the TM1638.
+        void start(void) override {
+          this->portClear(_stbOut, _stbMask);
+        }
+        // Send a stop signal to the TM1638 - the strobe must stay high for at least 1us before the next start.
+        void stop(void) override {
+          this->portSet(_stbOut, _stbMask);
+          delayMicroseconds(1);
+        }
+        // Write a byte of data to the TM1638 - LSB first, latched by the TM1638 on the rising clock edge.
+        void writeByte(uint8_t data) override {
+          uint8_t counter;
+          for(counter = 0; counter < 8; counter++) {
+            if(data & 0x01) {
+              this->portSet(_dinOut, _dinMask);
+            }
+            else {
+              this->portClear(_dinOut, _dinMask);
+            }
+            this->portSet(_clkOut, _clkMask);
+            this->pad();
+            this->portClear(_clkOut, _clkMask);
+            this->pad();
+            data >>= 1;
+          }
+        }
+        // Read a byte of data from the TM1638 - LSB first, sampled while the clock is high.
+        uint8_t readByte(void) override {
+          uint8_t counter, data = 0;
+          for(counter = 0; counter < 8; counter++) {
+            data >>= 1;
+            this->portSet(_clkOut, _clkMask);
+            this->pad();
+            if(*_dinIn & _dinMask) {
+              data |= 0x80;
+            }
+            this->portClear(_clkOut, _clkMask);
+            this->pad();
+          }
+          return data;
+        }
+        // Switch the data pin to an input (true), or back to an output (false).
+        void readMode(bool reading) override {
+          if(reading) {
+            this->portClear(_dinOut, _dinMask);             // No internal pull-up, the module provides one.
+            this->portClear(_dinMode, _dinMask);
+            delayMicroseconds(2);                           // The TM1638 needs at least 1us before the first key scan bit.
+          }
+          else {
+            this->portSet(_dinMode, _dinMask);
+          }
+        }
+      private:
+        volatile uint8_t* _stbOut;                        // The strobe pin output register.
+        volatile uint8_t* _clkOut;                        // The clock pin output register.
+        volatile uint8_t* _dinOut;                        // The data pin output register.
+        volatile uint8_t* _dinIn;                         // The data pin input register.
+        volatile uint8_t* _dinMode;                       // The data pin direction register.
+        uint8_t _stbMask;                                 // The strobe pin bit mask.
+        uint8_t _clkMask;                                 // The clock pin bit mask.
+        uint8_t _dinMask;                                 // The data pin bit mask.
+        // Set a port bit, without letting an interrupt that shares the port undo it (as digitalWrite does).
+        inline void portSet(volatile uint8_t* reg, uint8_t mask) {
+          uint8_t oldSREG = SREG;
+          cli();
+          *reg |= mask;
+          SREG = oldSREG;
+        }
+        // Clear a port bit, without letting an interrupt that shares the port undo it (as digitalWrite does).
+        inline void portClear(volatile uint8_t* reg, uint8_t mask) {
+          uint8_t oldSREG = SREG;
+          cli();
+          *reg &= ~mask;
+          SREG = oldSREG;
+        }
+        // Pad a clock phase to keep it above the 400ns datasheet minimum, even on a 20MHz AVR.
+        inline void pad(void) {
+          __asm__ __volatile__ ("nop\n\tnop\n\tnop\n\t");
+        }
+    };
+  #else
+    // On other architectures the port I/O transport is simply the bit banged transport.
+    template <uint8_t STB, uint8_t CLK, uint8_t DIN>
+    class TM1638PortIO : public TM1638BitBang {
+      public:
+        TM1638PortIO() : TM1638BitBang(STB, CLK, DIN) {}
+    };
+  #endif
+
+  // A TM1638 with its pins fixed at compile time, using the port I/O transport - the display size is chosen at runtime by begin().
+  template <uint8_t STB, uint8_t CLK, uint8_t DIN>
+  class TM1638Fast : public TM1638Base {
+    public:
+      // TM1638Fast Class instantiation.
+      TM1638Fast() : TM1638Base(_portIO, &_size, _storage, 16) {}
+      // Set up the display and initialise it with defaults values - with the default digit map.
+      void begin(uint8_t numButtons = DEF_BUTTONS38, uint8_t numLEDs = DEF_LEDS38, uint8_t numDigits = DEF_DIGITS38, uint8_t brightness = INTENSITY_TYP38) {
+        this->configure(&_size, nullptr, numButtons, numLEDs, numDigits, brightness);
+      }
+      // Set up the display and initialise it with defaults values - with a supplied digit map.
+      void begin(uint8_t* tmDigitMap, uint8_t numButtons = DEF_BUTTONS38, uint8_t numLEDs = DEF_LEDS38, uint8_t numDigits = DEF_DIGITS38, uint8_t brightness = INTENSITY_TYP38) {
+        this->configure(&_size, tmDigitMap, numButtons, numLEDs, numDigits, brightness);
+      }
+    private:
+      TM1638PortIO<STB, CLK, DIN> _portIO;                // The port I/O transport.
+      TM1638Config _size = {DEF_DIGITS38, DEF_LEDS38, DEF_BUTTONS38, 16, nullptr}; // The display size set by begin().
+      uint8_t _storage[16 + MAX_DIGITS38] = {0};          // The 16 display RAM values last written, then the 8 digit values.
+  };
+
+  // The number of physical display RAM addresses written - only those of the digits and LEDs, unless there is a digit map.
+  constexpr uint8_t tmChipSize38(const uint8_t* digitMap, uint8_t digits, uint8_t LEDs) {
+    return digitMap ? 16 : ((digits > LEDs) ? digits : LEDs) << 1;
+  }
+  // Get the physical digit for a logical digit, through a (constexpr) digit map.
+  constexpr uint8_t tmPhysDigit38(const uint8_t* digitMap, uint8_t digit) {
+    return digitMap ? digitMap[digit] : digit;
+  }
+
+  // A TM1638 with its digits, LEDs, buttons and (optional) digit map fixed at compile time, and checked by static_asserts.
+  // The per-digit functions also take the digit as a template argument, so a digit that is not on the display
+  //   is a compile error rather than a runtime check, and its physical address is resolved by the compiler.
+  // Its display size and digit map are a single constant shared by every instance, rather than fields in each one, and it
+  //   holds no transport of its own. It holds only the digit values and display RAM values it can use - a byte for each digit,
+  //   and two for each of the physical digits it writes (all 8 with a digit map), so a 4 digit, 4 LED display needs 12 bytes rather than 24.
+  template <uint8_t DIGITS, uint8_t LEDS = DEF_LEDS38, uint8_t BUTTONS = DEF_BUTTONS38, const uint8_t* DIGITMAP = nullptr>
+  class TM1638T : public TM1638Base {
+    static_assert(DIGITS > 0 && DIGITS <= MAX_DIGITS38, "A TM1638 has 1 to 8 digits.");
+    static_assert(LEDS <= MAX_LEDS38, "A TM1638 module has up to 8 LEDs.");
+    static_assert(BUTTONS <= MAX_BUTTONS38, "A TM1638 module has up to 8 buttons.");
+    public:
+      // TM1638T Class instantiation - with a supplied transport, e.g. a TM1638BitBang or TM1638PortIO.
+      TM1638T(TM1638Transport& transport) : TM1638Base(transport, &_size, _storage, _size.chipSize) {}
+      using TM1638Base::displayChar;                      // The runtime checked functions are still available.
+      using TM1638Base::displayString;
+      using TM1638Base::displayNumber;
+      using TM1638Base::displayLED1;
+      using TM1638Base::displayDP;
+      // Set up the display and initialise it with the compile time configuration.
+      void begin(uint8_t brightness = INTENSITY_TYP38) {
+        this->initialise(brightness);
+      }
+      // Clear all the LEDs and digits (+dps) in the display - every address is marked at once, with a mask made by the compiler.
+      void displayClear(void) {
+        STATS_CALL38(STATS_CLEAR38);
+        uint8_t digit;
+        *_LEDs = 0;                                       // Turn OFF all the TM1638 module LEDs.
+        _greenLEDs = 0;
+        for(digit = 0; digit < DIGITS; digit++) {
+          _registers[digit] = 0x00;                       // Turn OFF all the segments and decimal points.
+        }
+        _dirtyRAM |= usedMask(0);                         // Mark every digit and LED as changed.
+        this->refresh();
+      }
+      // Display a character in a specific digit.
+      template <uint8_t DIGIT>
+      void displayChar(uint8_t number, bool raw = false) {
+        static_assert(DIGIT < DIGITS, "The digit is not on the display.");
+        STATS_CALL38(STATS_CHAR38);
+        if(raw) {
+          number &= 0x7f;                                 // Ensure there are only 7 segment bits.
+        }
+        else {
+          number = (number < charTableSize) ? this->charCode(number) : 0x00;
+        }
+        _registers[DIGIT] = number | (_registers[DIGIT] & DP_CTRL38);
+        _dirtyRAM |= (uint16_t)1 << (physical(DIGIT) << 1); // Mark the character digit as changed.
+        this->refresh();
+      }
+      // Display an ASCII string from RAM or flash, starting at a specific digit.
+      template <uint8_t DIGIT, typename TEXT>
+      void displayString(TEXT text) {
+        static_assert(DIGIT < DIGITS, "The digit is not on the display.");
+        TM1638Base::displayString(DIGIT, text);
+      }
+      // Display a 32-bit integer in a field of digits that must fit on the display.
+      template <uint8_t DIGIT, uint8_t WIDTH>
+      void displayNumber(int32_t number, uint8_t base = 10, uint8_t dpPos = NO_DP38, uint8_t flags = NUM_BLANKS38) {
+        static_assert(WIDTH > 0 && DIGIT + WIDTH <= DIGITS, "The number field is not on the display.");
+        TM1638Base::displayNumber(DIGIT, WIDTH, number, base, dpPos, flags);
+      }
+      // Turn ON/OFF the LED at a specific position.
+      template <uint8_t LED>
+      void displayLED1(bool status = OFF) {
+        static_assert(LED < LEDS, "The LED is not on the module.");
+        STATS_CALL38(STATS_LED138);
+        bitWrite(*_LEDs, LED, status);
+        _dirtyRAM |= (uint16_t)1 << ((physical(LED) << 1) + 1); // Mark the LED as changed.
+        this->refresh();
+      }
+      // Turn ON/OFF the decimal point in a specific digit.
+      template <uint8_t DIGIT>
+      void displayDP(bool status = OFF) {
+        static_assert(DIGIT < DIGITS, "The digit is not on the display.");
+        STATS_CALL38(STATS_DP38);
+        bitWrite(_registers[DIGIT], 7, status);
+        _dirtyRAM |= (uint16_t)1 << (physical(DIGIT) << 1); // Mark the digit decimal point as changed.
+        this->refresh();
+      }
+    private:
+      static constexpr TM1638Config _size = {DIGITS, LEDS, BUTTONS, tmChipSize38(DIGITMAP, DIGITS, LEDS), DIGITMAP}; // The display size.
+      uint8_t _storage[tmChipSize38(DIGITMAP, DIGITS, LEDS) + DIGITS] = {0}; // The display RAM values last written, then the digit values.
+      // Get the physical digit for a logical digit - at compile time for a constexpr digit map.
+      static constexpr uint8_t physical(uint8_t digit) {
+        return tmPhysDigit38(DIGITMAP, digit);
+      }
+      // Get a bit for the physical display RAM address of each digit and LED, from a logical digit onwards.
+      static constexpr uint16_t usedMask(uint8_t digit) {
+        return (digit >= DIGITS && digit >= LEDS) ? 0 :
+               (uint16_t)(((digit < DIGITS) ? 0x01 : 0x00) | ((digit < LEDS) ? 0x02 : 0x00)) << (physical(digit) << 1) | usedMask(digit + 1);
+      }
+  };
+  template <uint8_t DIGITS, uint8_t LEDS, uint8_t BUTTONS, const uint8_t* DIGITMAP>
+  constexpr TM1638Config TM1638T<DIGITS, LEDS, BUTTONS, DIGITMAP>::_size;
 #endif
 
 // EOF
\ No newline at end of file
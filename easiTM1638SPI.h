@@ -0,0 +1,84 @@
+/*!
+ * An Easy TM1638 Arduino Library.
+ *  Simple, functional, optimal, and all in a class!
+ *
+ * The TM1638 is an (up to) 8-Digit 7-Segment (+dps) LED display driver.
+ *
+ * Written for the Arduino Uno/Nano/Mega.
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * A hardware SPI transport for the TM1638, kept in its own header so that only
+ *   the sketches that include it depend on the Arduino SPI library.
+ *
+ * The TM1638 protocol is half-duplex and LSB first, with the clock idling high and
+ *   the data latched on the rising clock edge, which is SPI mode 3.
+ *
+ * Wiring:
+ *    SCK  -> TM1638 CLK
+ *    MOSI -> TM1638 DIO
+ *    MISO -> TM1638 DIO (only needed to read the buttons)
+ *    Any  -> TM1638 STB
+ *
+ * ***************************
+ * *  easiTM1638 SPI Header  *
+ * ***************************
+ */
+
+#ifndef __TM1638SPI_H
+  #define __TM1638SPI_H
+  #include <Arduino.h>
+  #include <SPI.h>
+  #include "easiTM1638.h"
+
+  // The TM1638 supports a maximum clock frequency of 1MHz.
+  #define SPI_CLOCK38     1000000
+
+  // A TM1638 transport that clocks each byte through the hardware SPI peripheral.
+  class TM1638SPI : public TM1638Transport {
+    public:
+      // TM1638SPI Class instantiation.
+      TM1638SPI(uint8_t stbPin = DEF_TM_STB38, uint32_t clock = SPI_CLOCK38) : _settings(clock, LSBFIRST, SPI_MODE3) {
+        _stbPin = stbPin;                                 // Record the TM1638 strobe pin.
+      }
+      // Set up the strobe pin for output, and the SPI peripheral.
+      void begin(void) override {
+        digitalWrite(_stbPin, HIGH);                      // The strobe idles high, so the first start() is a falling edge.
+        pinMode(_stbPin, OUTPUT);
+        SPI.begin();
+      }
+      // Send a start signal to the TM1638 - the SPI bus is held for the whole transaction.
+      void start(void) override {
+        SPI.beginTransaction(_settings);
+        digitalWrite(_stbPin, LOW);
+      }
+      // Send a stop signal to the TM1638, and release the SPI bus.
+      void stop(void) override {
+        digitalWrite(_stbPin, HIGH);
+        SPI.endTransaction();
+      }
+      // Write a byte of data to the TM1638.
+      void writeByte(uint8_t data) override {
+        SPI.transfer(data);
+      }
+      // Read a byte of data from the TM1638 - the TM1638 drives DIO, and MISO reads it.
+      uint8_t readByte(void) override {
+        return SPI.transfer(0xff);
+      }
+      // Release MOSI from DIO for the key scan read phase (true), or drive it again (false).
+      void readMode(bool reading) override {
+        if(reading) {
+          pinMode(MOSI, INPUT);
+          delayMicroseconds(2);                           // The TM1638 needs at least 1us before the first key scan bit.
+        }
+        else {
+          pinMode(MOSI, OUTPUT);
+        }
+      }
+    private:
+      SPISettings _settings;                              // The SPI clock, bit order and mode for the TM1638.
+      uint8_t _stbPin;                                    // The current TM1638 strobe pin.
+  };
+#endif
+
+// EOF
@@ -0,0 +1,108 @@
+/*!
+ * TM1638 Animation Example with a TM1638 based 8-digit (+dps) LED display module.
+ *
+ * Written for the Arduino Uno/Nano/Mega.
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * An alarm screen, animated without a single delay() - a scrolling message, a blinking time and LEDs,
+ *   and a spinner played from frames kept in flash. Press S1 to acknowledge the alarm.
+ *
+ * *******************************
+ * *  easiTM1638 Animate Sketch  *
+ * *******************************
+ */
+
+#include "easiTM1638.h"
+
+// Pin definitions for the TM1638 - the interface might look like I2C, but it is not!
+#define CLKPIN      2                                     // Clock.
+#define DIOPIN      3                                     // Data Out.
+#define STBPIN      4                                     // Strobe.
+
+// The number of LEDs, digits and buttons in the TM1638 based LED display.
+#define NUMLEDS     8
+#define NUMDIGITS   8
+#define NUMBUTTONS  8
+
+// The alarm screen stages, each shown for a few seconds.
+#define STAGE_MS    6000
+#define STAGE_SCROLL 0
+#define STAGE_BLINK  1
+#define STAGE_SPIN   2
+
+// The spinner frames - a segment chasing around the outside of the display, 8 digits (leftmost first) per frame.
+const uint8_t spinFrames[] PROGMEM = {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+// Instantiate a TM1638 display, an animation engine and a button service for it.
+TM1638 myDisplay(STBPIN, CLKPIN, DIOPIN);
+TM1638Animator myAnimator(myDisplay);
+TM1638Buttons myButtons(myDisplay);
+
+uint8_t stage = STAGE_SCROLL;
+unsigned long stageStart;
+bool alarm = true;
+
+void setup() {
+  myDisplay.begin(NUMBUTTONS, NUMLEDS, NUMDIGITS, INTENSITY_TYP38);
+  startStage();
+}
+
+void loop() {
+  if(alarm && millis() - stageStart >= STAGE_MS) {
+    stage = (stage == STAGE_SPIN) ? STAGE_SCROLL : stage + 1;
+    startStage();
+  }
+  myButtons.service();
+  if(alarm && myButtons.getEvent() == (BTN_PRESS38 | 0)) {
+    // The alarm has been acknowledged - stop everything, and leave the time showing.
+    alarm = false;
+    myAnimator.stop();
+    myAnimator.blink(0x00);
+    myDisplay.displayString(0, "  12.45  ");
+    myDisplay.displayLED8(0x00);
+  }
+  myAnimator.service();                                   // The animation costs (almost) nothing until a blink or frame is due.
+  // ... the rest of the sketch runs here, never waiting for the display.
+}
+
+// Start the next alarm screen stage.
+void startStage() {
+  stageStart = millis();
+  myAnimator.blink(0x00);
+  switch(stage) {
+    case STAGE_SCROLL:
+      myAnimator.scroll(F("ALARM - TANK 3 LEVEL HIGH. "), 250);
+      break;
+    case STAGE_BLINK:
+      myAnimator.stop();
+      myDisplay.displayString(0, "AL 12.45");
+      myDisplay.displayLED8(0xff);
+      myAnimator.blink(0x78, 0x10, 0xff);                 // Blink the time digits (+dp), and all the LEDs.
+      break;
+    default:
+      myDisplay.displayLED8(0x00);
+      myAnimator.play(spinFrames, sizeof(spinFrames) / 8, 50);
+  }
+}
+
+// EOF
@@ -0,0 +1,175 @@
+/*!
+ * TM1638 Bus Cost Benchmark with a TM1638 based 8-digit (+dps) LED display module.
+ *
+ * Written for the Arduino Uno/Nano/Mega.
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * Measures what each easiTM1638 library function costs on the bus - strobe transactions,
+ *   bytes, clock edges and time - by wrapping the bit banged transport in a counting transport.
+ * The results are printed to the serial monitor, so they can be compared after every library change.
+ * The counts do not need a TM1638 to be connected, but the times are only meaningful with one.
+ * With USE_STATS38 enabled in easiTM1638.h, the library's own time histogram is printed too.
+ *
+ * *****************************
+ * *  easiTM1638 Bench Sketch  *
+ * *****************************
+ */
+
+#include "easiTM1638.h"
+
+// Optimisation - Enable this to allow the F() macro to keep constant strings in flash, and out of RAM.
+#define USE_FLASH
+#ifdef USE_FLASH
+  #define FLASHSTR(x)       F(x)                          // Substitute with the F() macro.
+#else
+  #define FLASHSTR(x)       (x)                           // Substitute with just the original string.
+#endif
+
+// Pin definitions for the TM1638 - the interface might look like I2C, but it is not!
+#define CLKPIN      2                                     // Clock.
+#define DIOPIN      3                                     // Data Out.
+#define STBPIN      4                                     // Strobe.
+
+// The number of LEDs, digits and buttons in the TM1638 based LED display.
+#define NUMLEDS     8
+#define NUMDIGITS   8
+#define NUMBUTTONS  8
+
+// The number of times each function is called, the results are the average of all the calls.
+#define ITERATIONS  100
+
+// A transport that counts the strobe transactions and bytes, and passes everything on to another transport.
+class TM1638Counter : public TM1638Transport {
+  public:
+    TM1638Counter(TM1638Transport& transport) : _transport(transport) {}
+    uint32_t strobes = 0;                                 // The number of strobe transactions.
+    uint32_t bytes = 0;                                   // The number of bytes written or read.
+    void begin(void) override { _transport.begin(); }
+    void start(void) override { strobes++; _transport.start(); }
+    void stop(void) override { _transport.stop(); }
+    void writeByte(uint8_t data) override { bytes++; _transport.writeByte(data); }
+    uint8_t readByte(void) override { bytes++; return _transport.readByte(); }
+    void readMode(bool reading) override { _transport.readMode(reading); }
+  private:
+    TM1638Transport& _transport;
+};
+
+// Instantiate a TM1638 display, with a counting transport wrapped around the default bit banged transport.
+TM1638BitBang myBus(STBPIN, CLKPIN, DIOPIN);
+TM1638Counter myCounter(myBus);
+TM1638 myDisplay(myCounter);
+
+uint16_t counter = 0;                                     // Changes the displayed values between calls.
+
+void bench(const __FlashStringHelper* name, void (*function)(void), void (*prepare)(void) = nullptr);
+
+void setup() {
+  Serial.begin(9600);
+  myDisplay.begin(NUMBUTTONS, NUMLEDS, NUMDIGITS, INTENSITY_TYP38);
+  Serial.println(FLASHSTR("\nFunction           Strobes   Bytes  Clocks  Time(us)"));
+  bench(FLASHSTR("displayClear"),      []() { myDisplay.displayClear(); }, fill);
+  bench(FLASHSTR("displayBrightness"), []() { myDisplay.displayBrightness(counter & INTENSITY_MAX38); });
+  bench(FLASHSTR("displayTest"),       []() { myDisplay.displayTest(counter & 0x01); });
+  bench(FLASHSTR("displayBin8"),       []() { myDisplay.displayBin8(counter); });
+  bench(FLASHSTR("displayChar"),       []() { myDisplay.displayChar(0, counter & 0x0f); });
+  bench(FLASHSTR("displayString"),     []() { myDisplay.displayString(0, (counter & 0x01) ? "HELLO.123" : "12345678"); });
+  bench(FLASHSTR("displayInt8"),       []() { myDisplay.displayInt8(0, counter % 100); });
+  bench(FLASHSTR("displayInt12"),      []() { myDisplay.displayInt12(0, counter % 1000); });
+  bench(FLASHSTR("displayInt16"),      []() { myDisplay.displayInt16(0, counter % 10000); });
+  bench(FLASHSTR("displayNumber"),     []() { myDisplay.displayNumber(0, 8, -123L * counter, 10, 2); });
+  bench(FLASHSTR("displayLED8"),       []() { myDisplay.displayLED8(counter); });
+  bench(FLASHSTR("displayLED1"),       []() { myDisplay.displayLED1(0, counter & 0x01); });
+  bench(FLASHSTR("displayDP"),         []() { myDisplay.displayDP(0, counter & 0x01); });
+  bench(FLASHSTR("batched frame"),     []() { frame(); });
+  bench(FLASHSTR("readButtons"),       []() { myDisplay.readButtons(); });
+  bench(FLASHSTR("readKeyMatrix"),     []() { myDisplay.readKeyMatrix(); });
+  myDisplay.displayClear();
+#ifdef USE_STATS38
+  printHistogram();
+#endif
+}
+
+void loop() {
+}
+
+// Call a function ITERATIONS times, and print its average bus cost.
+// The optional prepare function is called before each call, and its bus cost is not counted.
+void bench(const __FlashStringHelper* name, void (*function)(void), void (*prepare)(void)) {
+  unsigned long timeStart, timeTaken = 0;
+  uint32_t strobes = 0, bytes = 0;
+  uint16_t iteration;
+  for(iteration = 0; iteration < ITERATIONS; iteration++) {
+    counter++;
+    if(prepare) {
+      prepare();
+    }
+    myCounter.strobes = 0;                                // Only count the bus use of the function itself.
+    myCounter.bytes = 0;
+    timeStart = micros();
+    function();
+    timeTaken += micros() - timeStart;
+    strobes += myCounter.strobes;
+    bytes += myCounter.bytes;
+  }
+  printName(name, 18);
+  printNumber(strobes / ITERATIONS, 8);
+  printNumber(bytes / ITERATIONS, 8);
+  printNumber((bytes * 16) / ITERATIONS, 8);    // Each bit is a rising and a falling clock edge.
+  printNumber(timeTaken / ITERATIONS, 10);
+  Serial.println();
+}
+
+// A whole frame of changes, written as a single batch.
+void frame() {
+  myDisplay.beginUpdate();
+  myDisplay.displayInt16(0, counter);
+  myDisplay.displayInt16(4, counter >> 4, false);
+  myDisplay.displayLED8(counter);
+  myDisplay.displayDP(3, counter & 0x01);
+  myDisplay.endUpdate();
+}
+
+// Light every digit and LED, so there is something to clear.
+void fill() {
+  myDisplay.displayString(0, "8.8.8.8.8.8.8.8.");
+  myDisplay.displayLEDs(0xffff);
+}
+
+#ifdef USE_STATS38
+// Print the library's own time histogram of every function call made by the benchmark.
+void printHistogram() {
+  const TM1638Stats& stats = myDisplay.getStats();
+  uint8_t bin;
+  Serial.println(FLASHSTR("\nTime(us) from       Calls"));
+  for(bin = 0; bin < STATS_BINS38; bin++) {
+    printNumber(bin ? (8UL << bin) : 0, 13);
+    printNumber(stats.histogram[bin], 12);
+    Serial.println();
+  }
+}
+#endif
+
+// Print a function name, left aligned in a fixed width column.
+void printName(const __FlashStringHelper* name, uint8_t width) {
+  uint8_t length = strlen_P(reinterpret_cast<const char*>(name));
+  Serial.print(name);
+  while(length++ < width) {
+    Serial.print(' ');
+  }
+}
+
+// Print a number, right aligned in a fixed width column.
+void printNumber(uint32_t number, uint8_t width) {
+  uint8_t length = 1;
+  uint32_t scale;
+  for(scale = 10; scale <= number && length < 10; scale *= 10) {
+    length++;                                             // Count the decimal digits in the number.
+  }
+  while(length++ < width) {
+    Serial.print(' ');
+  }
+  Serial.print(number);
+}
+
+// EOF
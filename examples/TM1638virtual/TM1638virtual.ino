@@ -0,0 +1,153 @@
+/*!
+ * TM1638 Virtual Device Checks, without a TM1638 based module.
+ *
+ * Written for the Arduino Uno/Nano/Mega.
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * Runs the easiTM1638 library against a virtual TM1638, which decodes the bus traffic exactly as a TM1638 would.
+ * Golden frames - the display RAM expected after a function call - are checked byte for byte, and drawn as ASCII art.
+ * Then random function calls are made to two displays, one updating immediately and one batching its updates,
+ *   and their display RAM must always match a model of what it should hold, without a single protocol error.
+ * The results are printed to the serial monitor.
+ *
+ * *******************************
+ * *  easiTM1638 Virtual Sketch  *
+ * *******************************
+ */
+
+#include "easiTM1638.h"
+
+// Optimisation - Enable this to allow the F() macro to keep constant strings in flash, and out of RAM.
+#define USE_FLASH
+#ifdef USE_FLASH
+  #define FLASHSTR(x)       F(x)                          // Substitute with the F() macro.
+#else
+  #define FLASHSTR(x)       (x)                           // Substitute with just the original string.
+#endif
+
+// The number of LEDs, digits and buttons in the virtual TM1638 based LED display.
+#define NUMLEDS     8
+#define NUMDIGITS   8
+#define NUMBUTTONS  8
+
+// The number of random function calls to make.
+#define ITERATIONS  1000
+
+// Instantiate two TM1638 displays, each with its own virtual TM1638.
+TM1638Virtual myDevice, myBatchDevice;
+TM1638 myDisplay(myDevice);
+TM1638 myBatchDisplay(myBatchDevice);
+
+// The golden frames - the expected display RAM, digit segments (+dp) and LED for each of the 8 digits.
+const uint8_t goldenString[16] PROGMEM = {0x76, 0x00, 0x79, 0x00, 0x38, 0x00, 0x38, 0x00, 0x3f, 0x00, 0x00, 0x00, 0x06, 0x00, 0xdb, 0x00};
+const uint8_t goldenNumber[16] PROGMEM = {0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x40, 0x01, 0x06, 0x00, 0xdb, 0x01, 0x4f, 0x00, 0x66, 0x01};
+
+void setup() {
+  Serial.begin(9600);
+  Serial.println(FLASHSTR("easiTM1638 Virtual Device Checks"));
+  myDisplay.begin(NUMBUTTONS, NUMLEDS, NUMDIGITS);
+  myBatchDisplay.begin(NUMBUTTONS, NUMLEDS, NUMDIGITS);
+  // Check the golden frames.
+  myDisplay.displayString(0, "HELLO 12.");
+  checkFrame(FLASHSTR("displayString()"), goldenString);
+  myDisplay.displayClear();
+  myDisplay.displayNumber(0, NUMDIGITS, -1234, 10, 2);
+  myDisplay.displayLED8(0x55);
+  checkFrame(FLASHSTR("displayNumber()"), goldenNumber);
+  // Check the key scan decoding, with K2 KS3 and K3 KS8 pressed.
+  myDevice.setKeyMatrix(0x00000480);
+  check(FLASHSTR("readKeyMatrix()"), myDisplay.readKeyMatrix() == 0x00000480);
+  // Check that random function calls give the display RAM the model expects, with and without batching.
+  checkRandom();
+  check(FLASHSTR("Protocol errors"), (myDevice.errors + myBatchDevice.errors) == 0);
+}
+
+void loop() {
+}
+
+// Print a check result.
+void check(const __FlashStringHelper* name, bool passed) {
+  Serial.print(name);
+  Serial.println(passed ? FLASHSTR(" - PASS") : FLASHSTR(" - FAIL"));
+}
+
+// Compare the virtual TM1638 display RAM with a golden frame, and draw the display.
+void checkFrame(const __FlashStringHelper* name, const uint8_t* golden) {
+  uint8_t address;
+  bool passed = true;
+  for(address = 0; address < 16; address++) {
+    passed &= (myDevice.getRAM(address) == pgm_read_byte(&golden[address]));
+  }
+  check(name, passed);
+  myDevice.render(Serial);
+}
+
+// Make the same random function calls to both displays, one of them batching its updates, and compare their display RAM
+//   with a model of what it should hold - kept here as the display RAM itself, the digits at even addresses and the LEDs at odd.
+void checkRandom(void) {
+  uint8_t model[16] = {0};
+  uint16_t counter;
+  uint8_t address, digit, value;
+  bool passed = true;
+  myDisplay.displayClear();
+  myBatchDisplay.displayClear();
+  randomSeed(1638);
+  for(counter = 0; counter < ITERATIONS && passed; counter++) {
+    digit = random(NUMDIGITS);
+    value = random(256);
+    if((counter & 0x07) == 0) {
+      myBatchDisplay.beginUpdate();
+    }
+    switch(random(6)) {
+      case 0:
+        myDisplay.displayChar(digit, value, true);
+        myBatchDisplay.displayChar(digit, value, true);
+        model[digit << 1] = (model[digit << 1] & 0x80) | (value & 0x7f);
+        break;
+      case 1:
+        myDisplay.displayLED1(digit, value & 0x01);
+        myBatchDisplay.displayLED1(digit, value & 0x01);
+        model[(digit << 1) + 1] = value & 0x01;
+        break;
+      case 2:
+        myDisplay.displayDP(digit, value & 0x01);
+        myBatchDisplay.displayDP(digit, value & 0x01);
+        model[digit << 1] = (model[digit << 1] & 0x7f) | ((value & 0x01) << 7);
+        break;
+      case 3:
+        myDisplay.displayLED8(value);
+        myBatchDisplay.displayLED8(value);
+        for(address = 0; address < 8; address++) {
+          model[(address << 1) + 1] = (value >> (7 - address)) & 0x01; // The MSB is LED 0.
+        }
+        break;
+      case 4:
+        myDisplay.displayBin8(value, true);
+        myBatchDisplay.displayBin8(value, true);
+        for(address = 0; address < 8; address++) {
+          model[address << 1] = (model[address << 1] & 0x80) | (((value >> address) & 0x01) ? 0x06 : 0x3f); // The LSB is digit 0.
+        }
+        break;
+      default:
+        myDisplay.displayString(digit, "8.8");
+        myBatchDisplay.displayString(digit, "8.8");
+        model[digit << 1] = 0xff;                         // An 8 with its dp...
+        if(digit < NUMDIGITS - 1) {
+          model[(digit << 1) + 2] = 0x7f;                 // ...and an 8 without.
+        }
+    }
+    for(address = 0; address < 16; address++) {
+      passed &= (myDevice.getRAM(address) == model[address]);
+    }
+    if((counter & 0x07) == 0x07) {
+      myBatchDisplay.endUpdate();
+      for(address = 0; address < 16; address++) {
+        passed &= (myBatchDevice.getRAM(address) == model[address]);
+      }
+    }
+  }
+  check(FLASHSTR("Random updates"), passed);
+}
+
+// EOF
@@ -0,0 +1,106 @@
+/*!
+ * A Host Stand-in for the Arduino Core, used to build and measure the easiTM1638 library on a PC or CI box.
+ *
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * *********************************
+ * *  easiTM1638 Host Arduino Core  *
+ * *********************************
+ */
+
+#include "Arduino.h"
+
+MockPin mockPins[MOCK_PINS];
+uint64_t mockNanos = 0;
+void (*mockEdgeHook)(uint8_t, uint8_t, uint64_t) = nullptr;
+uint8_t (*mockReadHook)(uint8_t) = nullptr;
+
+// Clear the edge counts, leaving the pin levels and time.
+void mockReset(void) {
+  uint8_t pin;
+  for(pin = 0; pin < MOCK_PINS; pin++) {
+    mockPins[pin].rising = 0;
+    mockPins[pin].falling = 0;
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  mockNanos += MOCK_DIGITAL_NS;
+  if(pin < MOCK_PINS) {
+    mockPins[pin].mode = mode;
+  }
+}
+
+// Write a pin, counting (and reporting) an edge if the level changes.
+void digitalWrite(uint8_t pin, uint8_t level) {
+  mockNanos += MOCK_DIGITAL_NS;
+  level = level ? HIGH : LOW;
+  if(pin >= MOCK_PINS || mockPins[pin].level == level) {
+    return;
+  }
+  mockPins[pin].level = level;
+  if(level) {
+    mockPins[pin].rising++;
+  }
+  else {
+    mockPins[pin].falling++;
+  }
+  if(mockEdgeHook) {
+    mockEdgeHook(pin, level, mockNanos);
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  mockNanos += MOCK_DIGITAL_NS;
+  return mockReadHook ? (mockReadHook(pin) ? HIGH : LOW) : LOW;
+}
+
+// The same bit sequence as the Arduino core shiftOut() - the data bit, then a clock pulse.
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t value) {
+  uint8_t counter;
+  for(counter = 0; counter < 8; counter++) {
+    if(bitOrder == LSBFIRST) {
+      digitalWrite(dataPin, (value >> counter) & 0x01);
+    }
+    else {
+      digitalWrite(dataPin, (value >> (7 - counter)) & 0x01);
+    }
+    digitalWrite(clockPin, HIGH);
+    digitalWrite(clockPin, LOW);
+  }
+}
+
+// The same bit sequence as the Arduino core shiftIn() - the clock goes high, the data bit is read, and the clock goes low.
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder) {
+  uint8_t counter, value = 0;
+  for(counter = 0; counter < 8; counter++) {
+    digitalWrite(clockPin, HIGH);
+    if(bitOrder == LSBFIRST) {
+      value |= digitalRead(dataPin) << counter;
+    }
+    else {
+      value |= digitalRead(dataPin) << (7 - counter);
+    }
+    digitalWrite(clockPin, LOW);
+  }
+  return value;
+}
+
+unsigned long millis(void) {
+  return mockNanos / 1000000;
+}
+
+unsigned long micros(void) {
+  return mockNanos / 1000;
+}
+
+void delay(unsigned long ms) {
+  mockNanos += (uint64_t)ms * 1000000;
+}
+
+void delayMicroseconds(unsigned int us) {
+  mockNanos += (uint64_t)us * 1000;
+}
+
+// EOF
@@ -0,0 +1,106 @@
+/*!
+ * A Host Stand-in for the Arduino Core, used to build and measure the easiTM1638 library on a PC or CI box.
+ *
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * Only what the library needs is provided. The digital pin functions keep the level of every pin,
+ *   count its rising and falling edges, and pass each edge to an optional hook, all against a simulated clock.
+ * Each digital pin function call advances the simulated clock by about what it takes on a 16MHz AVR,
+ *   so micros() - and the bus times reported by the benchmark - track a real Uno/Nano.
+ *
+ * ***********************************
+ * *  easiTM1638 Host Arduino Header  *
+ * ***********************************
+ */
+
+#ifndef __ARDUINO_HOST_H
+  #define __ARDUINO_HOST_H
+  #include <stdint.h>
+  #include <stddef.h>
+  #include <string.h>
+
+  #define HIGH            0x1
+  #define LOW             0x0
+  #define INPUT           0x0
+  #define OUTPUT          0x1
+  #define INPUT_PULLUP    0x2
+  #define LSBFIRST        0
+  #define MSBFIRST        1
+
+  // The simulated time taken by each digital pin function call, in nanoseconds (about that of a 16MHz AVR).
+  #ifndef MOCK_DIGITAL_NS
+    #define MOCK_DIGITAL_NS 3500
+  #endif
+  #define MOCK_PINS       64                              // The number of simulated digital pins.
+
+  // Program memory is simply RAM on the host.
+  #define PROGMEM
+  #define pgm_read_byte(address) (*(const uint8_t*)(address))
+  #define strlen_P        strlen
+  class __FlashStringHelper;
+  #define F(text)         (reinterpret_cast<const __FlashStringHelper*>(text))
+
+  #define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+  #define bitSet(value, bit) ((value) |= (1UL << (bit)))
+  #define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+  #define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+  #define min(a, b)       ((a) < (b) ? (a) : (b))
+  #define max(a, b)       ((a) > (b) ? (a) : (b))
+  #define noInterrupts()
+  #define interrupts()
+
+  typedef uint8_t byte;
+
+  // The simulated state of a digital pin.
+  struct MockPin {
+    uint8_t mode;                                         // INPUT, OUTPUT or INPUT_PULLUP.
+    uint8_t level;                                        // The level last written, LOW or HIGH.
+    uint32_t rising;                                      // The number of rising edges.
+    uint32_t falling;                                     // The number of falling edges.
+  };
+
+  extern MockPin mockPins[MOCK_PINS];                     // The simulated digital pins.
+  extern uint64_t mockNanos;                              // The simulated time, in nanoseconds.
+  extern void (*mockEdgeHook)(uint8_t, uint8_t, uint64_t); // Called with the pin, new level and time of every edge, if set.
+  extern uint8_t (*mockReadHook)(uint8_t);                // Called by digitalRead() for the pin level, LOW if not set.
+  void mockReset(void);                                   // Clear the edge counts, leaving the pin levels and time.
+
+  void pinMode(uint8_t, uint8_t);
+  void digitalWrite(uint8_t, uint8_t);
+  int digitalRead(uint8_t);
+  void shiftOut(uint8_t, uint8_t, uint8_t, uint8_t);
+  uint8_t shiftIn(uint8_t, uint8_t, uint8_t);
+  unsigned long millis(void);
+  unsigned long micros(void);
+  void delay(unsigned long);
+  void delayMicroseconds(unsigned int);
+
+  // A minimal Print, enough for TM1638Virtual::render() and TM1638::dumpTrace().
+  class Print {
+    public:
+      virtual ~Print(void) {}
+      virtual size_t write(uint8_t) = 0;
+      virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t count;
+        for(count = 0; count < size; count++) {
+          this->write(buffer[count]);
+        }
+        return size;
+      }
+      size_t print(const char* text) {
+        return this->write((const uint8_t*)text, strlen(text));
+      }
+      size_t print(char character) {
+        return this->write((uint8_t)character);
+      }
+      size_t println(const char* text) {
+        return this->print(text) + this->println();
+      }
+      size_t println(void) {
+        return this->write('\n');
+      }
+  };
+#endif
+
+// EOF
@@ -0,0 +1,114 @@
+/*!
+ * A Virtual TM1638 on the Host Stand-in's Pins, used to test the easiTM1638 library's bit banged transports.
+ *
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * ******************************
+ * *  easiTM1638 Host Pins File  *
+ * ******************************
+ */
+
+#include "TM1638Pins.h"
+
+TM1638Pins* TM1638Pins::_devices[PINS_DEVICES];
+uint8_t TM1638Pins::_numDevices = 0;
+
+// Class constructor - put the TM1638 on the pins.
+TM1638Pins::TM1638Pins(TM1638Virtual& device, uint8_t stbPin, uint8_t clkPin, uint8_t dataPin) {
+  _device  = &device;
+  _stbPin  = stbPin;
+  _clkPin  = clkPin;
+  _dataPin = dataPin;
+  if(_numDevices < PINS_DEVICES) {
+    _devices[_numDevices++] = this;
+  }
+  mockEdgeHook = edgeHook;
+  mockReadHook = readHook;
+}
+
+// Decode a pin edge, as the TM1638 does.
+void TM1638Pins::edge(uint8_t pin, uint8_t level, uint64_t nanos) {
+  bool reading;
+  if(pin == _stbPin) {
+    if(!level) {
+      if(_stopNanos && nanos - _stopNanos < PINS_STB_NS) {
+        _device->errors++;                                // The strobe was not high for long enough.
+      }
+      _selected = true;                                   // A start signal.
+      _bits = 0;
+      _device->start();
+    }
+    else if(_selected) {
+      if(_bits) {
+        _device->errors++;                                // A byte cut short by the stop signal.
+      }
+      _selected = false;                                  // A stop signal.
+      _stopNanos = nanos;
+      _device->stop();
+      if(_reading) {
+        _reading = false;
+        _device->readMode(false);
+      }
+    }
+    return;
+  }
+  if(!_selected) {
+    return;                                               // The TM1638 ignores the clock and data without its strobe.
+  }
+  if(pin == _dataPin && !_reading && mockPins[_clkPin].level) {
+    _device->errors++;                                    // The data changed while the clock was high.
+  }
+  if(pin != _clkPin || !level) {
+    return;                                               // Only the rising clock edge moves a bit.
+  }
+  reading = (mockPins[_dataPin].mode != OUTPUT);
+  if(reading != _reading) {
+    if(_bits) {
+      _device->errors++;                                  // The data direction changed part way through a byte.
+      _bits = 0;
+    }
+    _reading = reading;
+    _device->readMode(reading);
+  }
+  if(_reading) {
+    if(_bits == 0) {
+      _keyByte = _device->readByte();                     // The next key scan byte, driven a bit at a time.
+    }
+    _bits = (_bits + 1) & 0x07;
+    return;
+  }
+  _shift |= mockPins[_dataPin].level << _bits;            // Latch the data bit, LSB first.
+  if(++_bits == 8) {
+    _device->writeByte(_shift);
+    _shift = 0;
+    _bits = 0;
+  }
+}
+
+// Pass a pin edge to every TM1638 on the pins.
+void TM1638Pins::edgeHook(uint8_t pin, uint8_t level, uint64_t nanos) {
+  uint8_t device;
+  for(device = 0; device < _numDevices; device++) {
+    _devices[device]->edge(pin, level, nanos);
+  }
+}
+
+// Get the data pin level - the bit of the key scan byte being read, driven low by any TM1638 that is sending a 0,
+//   and otherwise held high by the module's pull-up.
+uint8_t TM1638Pins::readHook(uint8_t pin) {
+  uint8_t device, bit;
+  TM1638Pins* pins;
+  for(device = 0; device < _numDevices; device++) {
+    pins = _devices[device];
+    if(pins->_dataPin == pin && pins->_selected && pins->_reading) {
+      bit = (pins->_bits - 1) & 0x07;                     // The bit clocked out by the last rising clock edge.
+      if(!((pins->_keyByte >> bit) & 0x01)) {
+        return LOW;
+      }
+    }
+  }
+  return HIGH;
+}
+
+// EOF
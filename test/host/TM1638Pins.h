@@ -0,0 +1,49 @@
+/*!
+ * A Virtual TM1638 on the Host Stand-in's Pins, used to test the easiTM1638 library's bit banged transports.
+ *
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * Decodes the strobe, clock and data pin edges the library makes, as a TM1638 does - a transaction starts on the
+ *   falling strobe edge, and each data bit is latched (LSB first) on the rising clock edge - and passes the decoded
+ *   start, stop and bytes on to a TM1638Virtual. While the data pin is an input, the TM1638Virtual's key scan bytes
+ *   are driven onto it, a bit for each rising clock edge. Several can share the clock and data pins, each with its own strobe.
+ * Bitstream faults are added to the TM1638Virtual's protocol errors - a byte cut short by the strobe, the data changed
+ *   while the clock is high, or the strobe high for less than 1us between transactions.
+ *
+ * ********************************
+ * *  easiTM1638 Host Pins Header  *
+ * ********************************
+ */
+
+#ifndef __TM1638_PINS_H
+  #define __TM1638_PINS_H
+  #include "easiTM1638.h"
+
+  #define PINS_DEVICES    4                               // The number of TM1638s that can be on the pins.
+  #define PINS_STB_NS     1000                            // The minimum strobe high time between transactions, in nanoseconds.
+
+  class TM1638Pins {
+    public:
+      // TM1638Pins Class instantiation - the TM1638Virtual fed, and the strobe, clock and data pins watched.
+      TM1638Pins(TM1638Virtual&, uint8_t, uint8_t, uint8_t);
+    private:
+      static TM1638Pins* _devices[PINS_DEVICES];          // The TM1638s on the pins.
+      static uint8_t _numDevices;                         // The number of TM1638s on the pins.
+      TM1638Virtual* _device;                             // A pointer to the virtual TM1638 fed.
+      uint8_t _stbPin;                                    // The TM1638 strobe pin.
+      uint8_t _clkPin;                                    // The TM1638 clock pin.
+      uint8_t _dataPin;                                   // The TM1638 data pin.
+      bool _selected = false;                             // Is the strobe asserted?
+      bool _reading = false;                              // Is the data pin an input, for the key scan?
+      uint8_t _bits = 0;                                  // The number of bits of the current byte clocked so far.
+      uint8_t _shift = 0;                                 // The bits of the byte being written.
+      uint8_t _keyByte = 0;                               // The key scan byte being read.
+      uint64_t _stopNanos = 0;                            // The time of the last stop signal.
+      void edge(uint8_t, uint8_t, uint64_t);              // Decode a pin edge.
+      static void edgeHook(uint8_t, uint8_t, uint64_t);   // Pass a pin edge to every TM1638 on the pins.
+      static uint8_t readHook(uint8_t);                   // Get the data pin level driven by the TM1638s.
+  };
+#endif
+
+// EOF
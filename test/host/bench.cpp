@@ -0,0 +1,106 @@
+/*!
+ * TM1638 Bus Cost Benchmark, run on a PC or CI box against the host stand-in for the Arduino core.
+ *
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * Measures what each easiTM1638 library function costs on the bus - strobe transactions, bytes, clock edges
+ *   and the estimated time on a 16MHz AVR - from the pin edges the library makes, not from the library itself.
+ * Each function has a strobe and byte budget (for all its calls), set from the current library, and the
+ *   benchmark fails if any function goes over its budget - so a bus cost regression fails the build.
+ *
+ * *********************************
+ * *  easiTM1638 Host Bench Program  *
+ * *********************************
+ */
+
+#include <stdio.h>
+#include "easiTM1638.h"
+
+// Pin definitions for the TM1638.
+#define CLKPIN      2                                     // Clock.
+#define DIOPIN      3                                     // Data Out.
+#define STBPIN      4                                     // Strobe.
+
+// The number of times each function is called, the results are the average of all the calls.
+#define ITERATIONS  100
+
+TM1638 myDisplay(STBPIN, CLKPIN, DIOPIN);
+
+uint16_t counter = 0;                                     // Changes the displayed values between calls.
+bool overBudget = false;                                  // Has any function gone over its budget?
+
+// Call a function ITERATIONS times, print its average bus cost, and check it against its budget.
+// The optional prepare function is called before each call, and its bus cost is not counted.
+void bench(const char* name, void (*function)(void), uint32_t maxStrobes, uint32_t maxBytes, void (*prepare)(void) = nullptr) {
+  uint64_t timeStart, timeTaken = 0;
+  uint32_t strobes = 0, rising = 0, falling = 0, bytes, clocks;
+  uint16_t iteration;
+  mockReset();
+  for(iteration = 0; iteration < ITERATIONS; iteration++) {
+    counter++;
+    if(prepare) {
+      prepare();
+    }
+    strobes -= mockPins[STBPIN].falling;                  // Only count the edges made by the function itself.
+    rising  -= mockPins[CLKPIN].rising;
+    falling -= mockPins[CLKPIN].falling;
+    timeStart = mockNanos;
+    function();
+    timeTaken += mockNanos - timeStart;
+    strobes += mockPins[STBPIN].falling;
+    rising  += mockPins[CLKPIN].rising;
+    falling += mockPins[CLKPIN].falling;
+  }
+  clocks = rising + falling;
+  bytes  = rising / 8;                                    // Every byte is 8 clock pulses.
+  printf("%-18s %8.2f %8.2f %8.2f %10.1f", name, (double)strobes / ITERATIONS, (double)bytes / ITERATIONS,
+         (double)clocks / ITERATIONS, (double)timeTaken / ITERATIONS / 1000);
+  if(strobes > maxStrobes || bytes > maxBytes) {
+    printf("  OVER BUDGET (%lu strobes, %lu bytes)", (unsigned long)maxStrobes, (unsigned long)maxBytes);
+    overBudget = true;
+  }
+  printf("\n");
+}
+
+// A whole frame of changes, written as a single batch.
+void frame(void) {
+  myDisplay.beginUpdate();
+  myDisplay.displayInt16(0, counter);
+  myDisplay.displayInt16(4, counter >> 4, false);
+  myDisplay.displayLED8(counter);
+  myDisplay.displayDP(3, counter & 0x01);
+  myDisplay.endUpdate();
+}
+
+// Light every digit and LED, so there is something to clear.
+void fill(void) {
+  myDisplay.displayString(0, "8.8.8.8.8.8.8.8.");
+  myDisplay.displayLEDs(0xffff);
+}
+
+int main(void) {
+  myDisplay.begin(8, 8, 8, INTENSITY_TYP38);
+  printf("Function            Strobes    Bytes   Clocks   Time(us)\n");
+  bench("displayClear",      []() { myDisplay.displayClear(); }, 100, 1700, fill);
+  bench("displayBrightness", []() { myDisplay.displayBrightness(counter & INTENSITY_MAX38); }, 100, 100);
+  bench("displayTest",       []() { myDisplay.displayTest(counter & 0x01); }, 100, 1700);
+  bench("displayBin8",       []() { myDisplay.displayBin8(counter); }, 100, 416);
+  bench("displayChar",       []() { myDisplay.displayChar(0, counter & 0x0f); }, 99, 198);
+  bench("displayString",     []() { myDisplay.displayString(0, (counter & 0x01) ? "HELLO.123" : "12345678"); }, 100, 1600);
+  bench("displayInt8",       []() { myDisplay.displayInt8(0, counter % 100); }, 100, 222);
+  bench("displayInt12",      []() { myDisplay.displayInt12(0, counter % 1000); }, 100, 226);
+  bench("displayInt16",      []() { myDisplay.displayInt16(0, counter % 10000); }, 100, 228);
+  bench("displayNumber",     []() { myDisplay.displayNumber(0, 8, -123L * counter, 10, 2); }, 100, 638);
+  bench("displayLED8",       []() { myDisplay.displayLED8(counter); }, 104, 406);
+  bench("displayLED1",       []() { myDisplay.displayLED1(0, counter & 0x01); }, 100, 200);
+  bench("displayLEDs",       []() { myDisplay.displayLEDs(counter * 0x0101); }, 105, 488);
+  bench("displayDP",         []() { myDisplay.displayDP(0, counter & 0x01); }, 100, 200);
+  bench("batched frame",     []() { frame(); }, 247, 629);
+  bench("readButtons",       []() { myDisplay.readButtons(); }, 100, 500);
+  bench("readKeyMatrix",     []() { myDisplay.readKeyMatrix(); }, 100, 500);
+  bench("resync",            []() { myDisplay.resync(); }, 300, 1900);
+  return overBudget ? 1 : 0;
+}
+
+// EOF
@@ -0,0 +1,431 @@
+/*!
+ * TM1638 Class Tests, run on a PC or CI box against the host stand-in for the Arduino core.
+ *
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * Checks the classes built on a display - a chain of modules sharing the clock and data bus, the background frame
+ *   transfers, the time budgeted tick(), the button events and the animator - against virtual TM1638s.
+ * After each step every display RAM address of every virtual TM1638 is checked, not just the ones the step should change.
+ * Each test is run by name (ctest runs each one separately), or all of them when no name is given.
+ *
+ * ***********************************
+ * *  easiTM1638 Host Class Program  *
+ * ***********************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "easiTM1638.h"
+
+uint16_t fails = 0;                                       // The number of failed checks.
+
+// Check a condition, and report it if it fails.
+void check(const char* what, bool passed) {
+  if(!passed) {
+    printf("FAIL %s\n", what);
+    fails++;
+  }
+}
+
+// Check every display RAM address of a virtual TM1638 against what it should hold.
+void checkRAM(const char* what, TM1638Virtual& device, const uint8_t* expected) {
+  uint8_t address;
+  for(address = 0; address < 16; address++) {
+    if(device.getRAM(address) != expected[address]) {
+      printf("FAIL %s: address %u is %02x, expected %02x\n", what, address, device.getRAM(address), expected[address]);
+      fails++;
+    }
+  }
+  check("no protocol errors", device.errors == 0);
+}
+
+
+/*********************/
+/* Module Chain Test */
+/*********************/
+
+// The transport of one module in a chain - its own strobe, on a clock and data bus shared by all the modules,
+//   so every byte reaches each module whose strobe is asserted.
+class SharedBus : public TM1638Transport {
+  public:
+    TM1638Virtual device;                                 // The module's TM1638.
+    bool selected = false;                                // Is the module's strobe asserted?
+    void begin(void) override { device.begin(); }
+    void start(void) override { selected = true; device.start(); }
+    void stop(void) override { selected = false; device.stop(); }
+    void writeByte(uint8_t) override;
+    uint8_t readByte(void) override { return device.readByte(); }
+    void readMode(bool reading) override { device.readMode(reading); }
+};
+
+SharedBus chainBus[3];
+
+void SharedBus::writeByte(uint8_t data) {
+  uint8_t module;
+  for(module = 0; module < 3; module++) {
+    if(chainBus[module].selected) {
+      chainBus[module].device.writeByte(data);
+    }
+  }
+}
+
+// A TM1638 with 8 digits, a TM1638T with 4 digits and 4 LEDs (using only 8 addresses), and a TM1638 with 6 digits.
+TM1638 chainModule0(chainBus[0]);
+TM1638T<4, 4> chainModule1(chainBus[1]);
+TM1638 chainModule2(chainBus[2]);
+TM1638Base* chainModules[] = {&chainModule0, &chainModule1, &chainModule2};
+TM1638Chain chain(chainModules, 3);
+uint8_t chainModel[3][16];                                // What each module should hold.
+
+// Check every address of every module.
+void checkChain(const char* what) {
+  uint8_t module;
+  for(module = 0; module < 3; module++) {
+    checkRAM(what, chainBus[module].device, chainModel[module]);
+  }
+}
+
+void testChain(void) {
+  uint8_t module, address;
+  chainModule0.begin(8, 8, 8);
+  chainModule1.begin();
+  chainModule2.begin(8, 8, 6);
+  check("chain digits", chain.numDigits() == 18);
+  memset(chainModel, 0x00, sizeof(chainModel));
+  chain.displayClear();
+  checkChain("chain clear");
+  // A number field spanning modules 0 and 1, and an LED on module 1.
+  chain.displayNumber(6, 6, -12345L);
+  chain.displayLED1(9, true);
+  chainModel[0][12] = 0x40;                               // "-1" in digits 6 and 7 of module 0...
+  chainModel[0][14] = 0x06;
+  chainModel[1][0] = 0x5b;                                // ...and "2345" in digits 0 - 3 of module 1.
+  chainModel[1][2] = 0x4f;
+  chainModel[1][4] = 0x66;
+  chainModel[1][6] = 0x6d;
+  chainModel[1][3] = LED_RED38;
+  checkChain("chain number");
+  // The test lights only the addresses each module uses, and restores all of them.
+  chain.displayTest(true);
+  for(module = 0; module < 3; module++) {
+    for(address = 0; address < 16; address++) {
+      if(module == 1 && address >= 8) {
+        check("chain test leaves the unused addresses", chainBus[module].device.getRAM(address) == 0x00);
+      }
+      else {
+        check("chain test lights the used addresses", chainBus[module].device.getRAM(address) == ((address & 0x01) ? LED_BOTH38 : 0xff));
+      }
+    }
+  }
+  chain.displayTest(false);
+  checkChain("chain test restore");
+  // A string spanning modules 1 and 2, written as one batch.
+  chain.beginUpdate();
+  chain.displayString(10, "AbC");
+  chain.displayDP(17, true);
+  chain.endUpdate();
+  chainModel[1][4] = 0x77;
+  chainModel[1][6] = 0x7c;
+  chainModel[2][0] = 0x39;
+  chainModel[2][10] = DP_CTRL38;
+  checkChain("chain string");
+  chain.displayClear();
+  memset(chainModel, 0x00, sizeof(chainModel));
+  checkChain("chain clear again");
+}
+
+
+/******************************/
+/* Background Frame Send Test */
+/******************************/
+
+TM1638Virtual asyncDevice;
+TM1638 asyncDisplay(asyncDevice);
+TM1638Async async(asyncDisplay);
+uint8_t framesSent = 0;                                   // The number of frame completion callbacks.
+
+void frameSent(void) {
+  framesSent++;
+}
+
+void testAsync(void) {
+  uint8_t model[16] = {0}, step;
+  const uint8_t digits[8] = {0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f}; // "12345678".
+  asyncDisplay.begin();
+  async.begin(frameSent);
+  asyncDisplay.displayInt16(0, 1234);
+  checkRAM("async records only", asyncDevice, model);
+  check("async commit", async.commit());
+  check("async busy with a frame", async.busy());
+  for(step = 0; step < 3; step++) {
+    async.service();                                      // Part of the first frame.
+  }
+  // Two more commits while the first frame is being sent - the second merges into the first one waiting.
+  asyncDisplay.displayInt16(4, 5678);
+  check("async commit while sending", async.commit());
+  asyncDisplay.displayLED1(0, true);
+  check("async commit merges", async.commit());
+  check("async commit with no changes", !async.commit());
+  for(step = 0; async.busy() && step < 100; step++) {
+    async.service();
+  }
+  for(step = 0; step < 8; step++) {
+    model[step << 1] = digits[step];
+  }
+  model[1] = LED_RED38;
+  checkRAM("async frames", asyncDevice, model);
+  check("async callback once, when all the frames are sent", framesSent == 1);
+  // A brightness change is sent by service(), and keeps busy() true until it is.
+  asyncDisplay.displayBrightness(5);
+  check("async busy with a brightness change", async.busy());
+  check("async brightness not sent yet", asyncDevice.getIntensity() != 5);
+  async.service();
+  check("async brightness sent", asyncDevice.getIntensity() == 5 && !async.busy());
+  // end() writes the uncommitted changes.
+  asyncDisplay.displayChar(0, 9);
+  async.end();
+  model[0] = 0x67;
+  checkRAM("async end", asyncDevice, model);
+}
+
+
+/**********************/
+/* Budgeted Tick Test */
+/**********************/
+
+// A virtual TM1638 that takes time to clock each byte, so tick() has something to budget.
+class TimedDevice : public TM1638Virtual {
+  public:
+    void start(void) override { delayMicroseconds(5); TM1638Virtual::start(); }
+    void writeByte(uint8_t data) override { delayMicroseconds(20); TM1638Virtual::writeByte(data); }
+    uint8_t readByte(void) override { delayMicroseconds(20); return TM1638Virtual::readByte(); }
+};
+
+TimedDevice tickDevice;
+TM1638 tickDisplay(tickDevice);
+
+void testTick(void) {
+  uint8_t frame, calls, address, before[16];
+  uint32_t keys;
+  unsigned long timeStart;
+  bool done;
+  tickDisplay.begin(8, 8, 8);
+  tickDisplay.beginUpdate();
+  for(frame = 0; frame < 20; frame++) {
+    tickDisplay.displayNumber(0, 8, frame * 1234567L, 10, frame & 0x07);
+    tickDisplay.displayLED8(frame * 37);
+    if(frame % 5 == 0) {
+      tickDisplay.displayBrightness(frame & INTENSITY_MAX38);
+    }
+    if(frame % 3 == 0) {
+      tickDisplay.requestKeyMatrix();
+    }
+    tickDevice.setKeyMatrix(frame);
+    calls = 0;
+    do {
+      timeStart = micros();
+      done = tickDisplay.tick(120);
+      check("tick within its budget", micros() - timeStart <= 120);
+      calls++;
+    } while(!done && calls < 100);
+    check("tick finishes", done);
+    if(frame % 3 == 0) {
+      check("tick reads the key matrix", tickDisplay.getKeyMatrix(&keys) && keys == frame);
+    }
+    // Everything must already have been written - a resync rewrites the same values.
+    for(address = 0; address < 16; address++) {
+      before[address] = tickDevice.getRAM(address);
+    }
+    tickDisplay.resync();
+    checkRAM("tick writes every change", tickDevice, before);
+  }
+  // Too small a budget still makes progress, a unit (the brightness, a digit, the key scan) per call.
+  tickDisplay.displayBrightness(3);
+  tickDisplay.displayChar(0, 1);
+  tickDisplay.displayChar(7, 2);
+  tickDisplay.requestKeyMatrix();
+  for(calls = 0; !tickDisplay.tick(1) && calls < 20; calls++);
+  check("tick progresses a unit per call", calls == 3);
+  check("tick small budget writes", tickDevice.getIntensity() == 3 && tickDevice.getRAM(0) == 0x06 && tickDevice.getRAM(14) == 0x5b);
+  tickDisplay.endUpdate();
+}
+
+
+/**********************/
+/* Button Events Test */
+/**********************/
+
+TM1638Virtual buttonDevice;
+TM1638 buttonDisplay(buttonDevice);
+TM1638Buttons buttons(buttonDisplay);
+
+// Press buttons (a bit for each) on the virtual TM1638 - buttons 0-3 are K3 x KS1/3/5/7, buttons 4-7 are K3 x KS2/4/6/8.
+void pressButtons(uint8_t pressed) {
+  uint8_t button;
+  uint32_t matrix = 0;
+  for(button = 0; button < 8; button++) {
+    if(pressed & (1 << button)) {
+      matrix |= (uint32_t)1 << ((button < 4) ? (button << 1) : (((button - 4) << 1) + 1));
+    }
+  }
+  buttonDevice.setKeyMatrix(matrix);
+}
+
+void testButtons(void) {
+  uint16_t time, presses = 0, longs = 0, repeats = 0, releases = 0, others = 0;
+  uint8_t event, order = 0;
+  buttonDisplay.begin();
+  buttons.begin(10, 100, 50);
+  for(time = 0; time < 600; time++) {
+    if(time >= 20 && time < 300) {
+      pressButtons((time >= 100 && time < 115) ? 0x00 : 0x02); // Button 1 held, with a bounce too short to be a release.
+    }
+    else if(time >= 400 && time < 460) {
+      pressButtons(0x20);                                 // Button 5 pressed briefly.
+    }
+    else {
+      pressButtons(0x00);
+    }
+    buttons.service();
+    if(time == 250) {
+      check("button held state", buttons.getState() == 0x02);
+    }
+    while((event = buttons.getEvent()) != BTN_NONE38) {
+      if(event == (BTN_PRESS38 | 1)) {
+        check("button press first", order == 0);
+        order = 1;
+        presses++;
+      }
+      else if(event == (BTN_LONG38 | 1)) {
+        check("button long press after the press", order == 1);
+        order = 2;
+        longs++;
+      }
+      else if(event == (BTN_REPEAT38 | 1)) {
+        check("button repeats after the long press", order == 2);
+        repeats++;
+      }
+      else if(event == (BTN_RELEASE38 | 1)) {
+        check("button release last", order == 2);
+        order = 3;
+        releases++;
+      }
+      else if(event != (BTN_PRESS38 | 5) && event != (BTN_RELEASE38 | 5)) {
+        others++;                                         // A short press of button 5 has no long press.
+      }
+    }
+    delay(1);
+  }
+  check("button events", presses == 1 && longs == 1 && repeats >= 2 && releases == 1 && others == 0);
+  check("button released state", buttons.getState() == 0x00);
+}
+
+
+/*****************/
+/* Animator Test */
+/*****************/
+
+TM1638Virtual animDevice;
+TM1638 animDisplay(animDevice);
+
+void testAnimator(void) {
+  const uint8_t frames[] PROGMEM = {0x01, 0, 0, 0, 0, 0, 0, 0x08,  0, 0x01, 0, 0, 0, 0, 0x08, 0};
+  uint8_t model[16] = {0}, step;
+  uint32_t bytes;
+  animDisplay.begin(8, 8, 4);
+  {
+    TM1638Animator animator(animDisplay);
+    TM1638Animator second(animDisplay);
+    // Scroll a string onto the 4 digits, entering from the right.
+    animator.scroll("HELP", 100, false);
+    checkRAM("scroll starts blank", animDevice, model);
+    delay(100);
+    animator.service();
+    model[6] = 0x76;                                      // 'H' in the rightmost digit.
+    checkRAM("scroll first step", animDevice, model);
+    for(step = 0; step < 3; step++) {
+      delay(100);
+      animator.service();
+    }
+    model[0] = 0x76;
+    model[2] = 0x79;
+    model[4] = 0x38;
+    model[6] = 0x73;
+    checkRAM("scroll whole text", animDevice, model);
+    animator.stop();
+    check("scroll stopped", !animator.busy());
+    // Blink digits 0 and 1, the dp of digit 1, and LED 2 - hidden without changing the digit values.
+    animDisplay.displayString(0, "12.34");
+    animDisplay.displayLED1(2, true);
+    second.blink(0x0f);                                   // Not registered with the display, so this does nothing.
+    animator.blink(0x03, 0x02, 0x04, 500);
+    delay(500);
+    animator.service();
+    memset(model, 0x00, sizeof(model));
+    model[4] = 0x4f;
+    model[6] = 0x66;
+    checkRAM("blink off phase", animDevice, model);
+    animDisplay.displayChar(0, 7);                        // A hidden digit can still be changed.
+    delay(500);
+    animator.service();
+    model[0] = 0x07;
+    model[2] = 0x5b | DP_CTRL38;
+    model[5] = LED_RED38;
+    checkRAM("blink on phase", animDevice, model);
+    delay(500);
+    animator.service();
+    bytes = animDevice.bytes;
+    delay(10);
+    animator.service();
+    check("blink idle between phases", animDevice.bytes == bytes);
+    // Destroying the animator shows what its blink hid, and unregisters it.
+  }
+  checkRAM("animator destroyed", animDevice, model);
+  animDisplay.displayChar(1, 1);
+  model[2] = 0x06 | DP_CTRL38;                            // The character keeps the digit's dp.
+  checkRAM("display without an animator", animDevice, model);
+  {
+    // Play two frames, leaving the last one on the display.
+    TM1638Animator animator(animDisplay);
+    animator.play(frames, 2, 100, false);
+    while(animator.busy()) {
+      delay(10);
+      animator.service();
+    }
+    memset(model, 0x00, sizeof(model));
+    model[2] = 0x01;                                      // Only the first 4 digits of each frame are on the display...
+    model[5] = LED_RED38;                                 // ...and the LEDs are left alone.
+    checkRAM("play last frame", animDevice, model);
+  }
+}
+
+
+// The tests, run by name.
+struct Test {
+  const char* name;
+  void (*function)(void);
+};
+
+const Test tests[] = {
+  {"chain",    testChain},
+  {"async",    testAsync},
+  {"tick",     testTick},
+  {"buttons",  testButtons},
+  {"animator", testAnimator}
+};
+
+int main(int argc, char** argv) {
+  uint8_t test;
+  uint16_t failsBefore;
+  for(test = 0; test < sizeof(tests) / sizeof(tests[0]); test++) {
+    if(argc < 2 || strcmp(argv[1], tests[test].name) == 0) {
+      failsBefore = fails;
+      tests[test].function();
+      printf("%-10s %s\n", tests[test].name, (fails != failsBefore) ? "FAILED" : "passed");
+    }
+  }
+  return fails ? 1 : 0;
+}
+
+// EOF
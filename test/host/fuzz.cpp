@@ -0,0 +1,437 @@
+/*!
+ * TM1638 Display RAM Fuzz Test, run on a PC or CI box against the host stand-in for the Arduino core.
+ *
+ * (c) Ian Neill 2025
+ * GPL(v3) Licence
+ *
+ * Makes random library function calls to a display with a virtual TM1638, and after every call compares what the
+ *   virtual TM1638 holds with a model of the display RAM that should be there. The model is written from the documented
+ *   behaviour of each function, with its own font and number formatting, and shares no code with the library.
+ * Each display set up is checked - with and without a digit map, with fewer digits than LEDs, as a TM1638 and a TM1638T,
+ *   batching its updates, during and after displayTest(), and with LED and dp changes made from an interrupt.
+ * Most set ups use the TM1638Virtual as their transport, so the bytes are checked. The last two use the bit banged
+ *   transports on a shared clock and data bus, decoded from the pin edges by TM1638Pins, so the bitstream is checked too.
+ * The key matrix is then read back through each set up.
+ *
+ * ********************************
+ * *  easiTM1638 Host Fuzz Program  *
+ * ********************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "easiTM1638.h"
+#include "TM1638Pins.h"
+
+// The number of random function calls to make, for each display set up.
+#define ITERATIONS  5000
+#define KEY_SCANS   20
+
+// Pin definitions for the bit banged set ups, sharing the clock and data pins.
+#define CLKPIN      2                                     // Clock.
+#define DIOPIN      3                                     // Data Out.
+#define STBPIN      4                                     // Strobe, for the TM1638.
+#define STB2PIN     5                                     // Strobe, for the TM1638T.
+
+// The model's own 7-segment font, for the characters it uses.
+const char modelChars[] = "0123456789AbCdEF -HELOP";
+const uint8_t modelFont[] = {0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x67,
+                             0x77, 0x7c, 0x39, 0x5e, 0x79, 0x71, 0x00, 0x40, 0x76, 0x79, 0x38, 0x3f, 0x73};
+
+// A display set up - the number of digits and LEDs, and the digit map (nullptr for the default).
+struct Setup {
+  const char* name;
+  uint8_t numDigits;
+  uint8_t numLEDs;
+  uint8_t* digitMap;
+};
+
+uint8_t reverseMap[8] = {7, 6, 5, 4, 3, 2, 1, 0};
+uint8_t swapMap[8] = {3, 2, 1, 0, 7, 6, 5, 4};
+
+const Setup setups[] = {
+  {"8 digits, 8 LEDs",                8, 8, nullptr},
+  {"8 digits, 8 LEDs, swapped map",   8, 8, swapMap},
+  {"6 digits, 8 LEDs, reversed map",  6, 8, reverseMap},
+  {"4 digits, 4 LEDs",                4, 4, nullptr},
+  {"TM1638T<4, 8>",                   4, 8, nullptr},
+  {"TM1638T<6, 8, 8, reversed map>",  6, 8, reverseMap},
+  {"8 digits, 8 LEDs, pins",          8, 8, nullptr},
+  {"TM1638T<6, 8, 8, rev. map>, pins", 6, 8, reverseMap}
+};
+
+// What the display should show - the segments (+dp) of each logical digit, each LED colour, and the pending interrupt changes.
+struct Model {
+  uint8_t segments[8];
+  uint8_t red;
+  uint8_t green;
+  uint8_t isrLEDs, isrLEDsMask;
+  uint8_t isrDPs, isrDPsMask;
+};
+
+const Setup* setup;
+Model model;
+uint32_t seed;
+uint32_t checks;
+const char* lastCall;
+
+// A small, repeatable, random number generator.
+uint32_t rnd(uint32_t range) {
+  seed = seed * 1103515245UL + 12345UL;
+  return ((seed >> 8) & 0xffffff) % range;
+}
+
+// Get the model's 7-segment code for a character.
+uint8_t font(char character) {
+  const char* found = strchr(modelChars, character);
+  return found ? modelFont[found - modelChars] : 0x00;
+}
+
+// Get the display RAM value the model expects at a physical address.
+uint8_t expected(uint8_t address) {
+  uint8_t physical = address >> 1, logical;
+  for(logical = 0; logical < 8; logical++) {
+    if((setup->digitMap ? setup->digitMap[logical] : logical) == physical) {
+      break;
+    }
+  }
+  if(address & 0x01) {
+    return (logical < setup->numLEDs) ? ((model.red >> logical) & 0x01) | (((model.green >> logical) & 0x01) << 1) : 0x00;
+  }
+  return (logical < setup->numDigits) ? model.segments[logical] : 0x00;
+}
+
+// Apply the pending interrupt changes to the model, as the next write to the display does.
+void merge(void) {
+  uint8_t digit;
+  model.red = (model.red & ~model.isrLEDsMask) | (model.isrLEDs & model.isrLEDsMask);
+  for(digit = 0; digit < 8; digit++) {
+    if((model.isrDPsMask >> digit) & 0x01) {
+      model.segments[digit] = (model.segments[digit] & 0x7f) | (((model.isrDPs >> digit) & 0x01) << 7);
+    }
+  }
+  model.isrLEDsMask = 0;
+  model.isrDPsMask = 0;
+}
+
+// Compare the virtual TM1638 display RAM with a frame, and report the first difference.
+bool compare(TM1638Virtual& device, const uint8_t* frame, const char* when) {
+  uint8_t address;
+  checks++;
+  for(address = 0; address < 16; address++) {
+    if(device.getRAM(address) != frame[address]) {
+      printf("  after %s (%s): address %u holds 0x%02x, expected 0x%02x\n", lastCall, when, address, device.getRAM(address), frame[address]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Compare the virtual TM1638 display RAM with the model.
+bool compareModel(TM1638Virtual& device, const char* when) {
+  uint8_t frame[16], address;
+  for(address = 0; address < 16; address++) {
+    frame[address] = expected(address);
+  }
+  return compare(device, frame, when);
+}
+
+// Model a number in a right aligned field, using printf() for the digits.
+void modelNumber(uint8_t digit, uint8_t width, int32_t number, uint8_t base, uint8_t dpPos, uint8_t flags) {
+  char text[24], digits[16];
+  uint8_t used, minimum, index;
+  bool negative = (base == 10) && (number < 0);
+  uint32_t magnitude = negative ? -(uint32_t)number : (uint32_t)number;
+  used = width - negative;
+  minimum = (flags & NUM_ZEROS38) ? used : (dpPos != NO_DP38 && dpPos < used) ? dpPos + 1 : 1;
+  snprintf(digits, sizeof(digits), (base == 10) ? "%.*lu" : "%.*lX", minimum, (unsigned long)magnitude);
+  if(strlen(digits) > used) {
+    memset(digits, (base == 10) ? '9' : 'F', used);       // Clipped at the maximum for the field.
+    digits[used] = '\0';
+  }
+  snprintf(text, sizeof(text), "%*s%s%s", (int)(width - negative - strlen(digits)), "", negative ? "-" : "", digits);
+  for(index = 0; index < width; index++) {
+    if(text[index] == 'B' || text[index] == 'D') {
+      text[index] += 0x20;                                // The font has a lower case b and d.
+    }
+    model.segments[digit + index] = font(text[index]) | ((dpPos == NO_DP38) ? (model.segments[digit + index] & 0x80) : 0x00);
+  }
+  if(dpPos != NO_DP38 && dpPos < width) {
+    model.segments[digit + width - 1 - dpPos] |= 0x80;
+  }
+}
+
+// Model a string - a '.' is merged into the decimal point of the digit before it, unless that digit already has one.
+void modelString(uint8_t digit, const char* text) {
+  bool dpFree = false;
+  for(; *text; text++) {
+    if(*text == '.' && dpFree) {
+      model.segments[digit - 1] |= 0x80;
+      dpFree = false;
+      continue;
+    }
+    if(digit >= setup->numDigits) {
+      break;
+    }
+    model.segments[digit] = (*text == '.') ? 0x80 : font(*text);
+    dpFree = (*text != '.');
+    digit++;
+  }
+}
+
+// Make one random library function call to the display, and the same change to the model. Returns true if the call
+//   writes to the display (unless batching), false if it only records a change from an interrupt.
+template <typename DISPLAY>
+bool randomCall(DISPLAY& display, bool batching) {
+  uint8_t digit = rnd(setup->numDigits), LED = rnd(setup->numLEDs), value = rnd(256), index, width, base, dpPos, flags;
+  uint8_t raw[8];
+  int32_t number;
+  char text[12];
+  switch(rnd(16)) {
+    case 0:
+      lastCall = "displayChar(raw)";
+      display.displayChar(digit, value, true);
+      model.segments[digit] = (value & 0x7f) | (model.segments[digit] & 0x80);
+      break;
+    case 1:
+      lastCall = "displayChar()";
+      display.displayChar(digit, value & 0x0f);
+      model.segments[digit] = modelFont[value & 0x0f] | (model.segments[digit] & 0x80);
+      break;
+    case 2:
+      lastCall = "displayDP()";
+      display.displayDP(digit, value & 0x01);
+      model.segments[digit] = (model.segments[digit] & 0x7f) | ((value & 0x01) << 7);
+      break;
+    case 3:
+      lastCall = "displayLED1()";
+      display.displayLED1(LED, value & 0x01);
+      model.red = (model.red & ~(1 << LED)) | ((value & 0x01) << LED);
+      break;
+    case 4:
+      lastCall = "displayLEDColour()";
+      display.displayLEDColour(LED, value & LED_BOTH38);
+      model.red = (model.red & ~(1 << LED)) | ((value & 0x01) << LED);
+      model.green = (model.green & ~(1 << LED)) | (((value >> 1) & 0x01) << LED);
+      break;
+    case 5:
+      lastCall = "displayLEDs()";
+      number = rnd(0x10000);
+      display.displayLEDs(number);
+      for(index = 0; index < setup->numLEDs; index++) {
+        model.red = (model.red & ~(1 << index)) | (((number >> index) & 0x01) << index);
+        model.green = (model.green & ~(1 << index)) | (((number >> (index + 8)) & 0x01) << index);
+      }
+      break;
+    case 6:
+      if(setup->numLEDs < 8) {
+        return randomCall(display, batching);
+      }
+      lastCall = "displayLED8()";
+      display.displayLED8(value, digit & 0x01);
+      for(index = 0; index < 8; index++) {
+        model.red = (model.red & ~(1 << index)) | ((((digit & 0x01) ? (value >> index) : (value >> (7 - index))) & 0x01) << index);
+      }
+      break;
+    case 7:
+      if(setup->numDigits < 8) {
+        return randomCall(display, batching);
+      }
+      lastCall = "displayBin8()";
+      display.displayBin8(value, digit & 0x01);
+      for(index = 0; index < 8; index++) {
+        model.segments[index] = (model.segments[index] & 0x80) |
+                                font((((digit & 0x01) ? (value >> index) : (value >> (7 - index))) & 0x01) ? '1' : '0');
+      }
+      break;
+    case 8:
+      lastCall = "displayString()";
+      width = rnd(sizeof(text));
+      for(index = 0; index < width; index++) {
+        text[index] = "0123456789 -HELOP.."[rnd(19)];
+      }
+      text[width] = '\0';
+      display.displayString(digit, text);
+      modelString(digit, text);
+      break;
+    case 9:
+      lastCall = "displayNumber()";
+      width = rnd(setup->numDigits - digit) + 1;
+      base = rnd(4) ? 10 : 16;
+      dpPos = rnd(3) ? NO_DP38 : rnd(width + 1);
+      flags = rnd(3) ? NUM_BLANKS38 : NUM_ZEROS38;
+      number = (int32_t)(seed ^ (seed << 7)) >> rnd(32);  // Numbers of every size, both signs.
+      if(width == 1 && base == 10 && number < 0) {
+        number = ~number;                                 // A single digit has no room for a minus sign.
+      }
+      display.displayNumber(digit, width, number, base, dpPos, flags);
+      modelNumber(digit, width, number, base, dpPos, flags);
+      break;
+    case 10:
+      lastCall = "displayRaw()";
+      width = rnd(9);
+      for(index = 0; index < width; index++) {
+        raw[index] = rnd(256);
+      }
+      display.displayRaw(digit, raw, width);
+      for(index = 0; index < width && digit + index < setup->numDigits; index++) {
+        model.segments[digit + index] = raw[index];
+      }
+      break;
+    case 11:
+      if(rnd(4)) {
+        return randomCall(display, batching);               // Clear less often, so the display fills up.
+      }
+      lastCall = "displayClear()";
+      display.displayClear();
+      memset(model.segments, 0, sizeof(model.segments));
+      model.red = 0;
+      model.green = 0;
+      break;
+    case 12:
+      lastCall = "displayLED1FromISR()";
+      display.displayLED1FromISR(LED, value & 0x01);
+      model.isrLEDs = (model.isrLEDs & ~(1 << LED)) | ((value & 0x01) << LED);
+      model.isrLEDsMask |= 1 << LED;
+      return false;
+    case 13:
+      lastCall = "displayDPFromISR()";
+      display.displayDPFromISR(digit, value & 0x01);
+      model.isrDPs = (model.isrDPs & ~(1 << digit)) | ((value & 0x01) << digit);
+      model.isrDPsMask |= 1 << digit;
+      return false;
+    case 14:
+      if(setup->numDigits < digit + 4) {
+        return randomCall(display, batching);
+      }
+      lastCall = "displayInt16()";
+      number = rnd(0x10000);
+      display.displayInt16(digit, number, value & 0x01);
+      modelNumber(digit, 4, number, (value & 0x01) ? 10 : 16, NO_DP38, NUM_ZEROS38);
+      break;
+    default:
+      if(batching) {
+        return randomCall(display, batching);               // displayTest() writes to the display straight away.
+      }
+      lastCall = "displayTest()";
+      return true;
+  }
+  return true;
+}
+
+// Show all the segments and LEDs with displayTest(true), check them, and then restore the display with displayTest(false).
+template <typename DISPLAY>
+bool checkTest(DISPLAY& display, TM1638Virtual& device) {
+  uint8_t frame[16], address;
+  for(address = 0; address < 16; address++) {
+    frame[address] = ((address >> 1) < max(setup->numDigits, setup->numLEDs)) ? ((address & 0x01) ? LED_BOTH38 : 0xff) : expected(address);
+  }
+  display.displayTest(true);
+  if(!compare(device, frame, "displayTest(true)")) {
+    return false;
+  }
+  display.displayTest(false);
+  merge();
+  return compareModel(device, "displayTest(false)");
+}
+
+// Set up a display with its size chosen at runtime...
+void beginDisplay(TM1638& display) {
+  display.begin(setup->digitMap, 8, setup->numLEDs, setup->numDigits);
+}
+
+// ...or at compile time.
+template <uint8_t DIGITS, uint8_t LEDS, uint8_t BUTTONS, const uint8_t* DIGITMAP>
+void beginDisplay(TM1638T<DIGITS, LEDS, BUTTONS, DIGITMAP>& display) {
+  display.begin();
+}
+
+// Run the random function calls for a display set up. Returns true if the display RAM always matched the model.
+template <typename DISPLAY>
+bool fuzz(const Setup& thisSetup, DISPLAY& display, TM1638Virtual& device) {
+  uint8_t batchRAM[16], address;
+  uint16_t iteration;
+  uint32_t number;
+  bool batching = false, passed = true;
+  setup = &thisSetup;
+  memset(&model, 0, sizeof(model));
+  checks = 0;
+  lastCall = "begin()";
+  seed = 1638 + (&thisSetup - setups);
+  beginDisplay(display);
+  passed = compareModel(device, "begin");
+  for(iteration = 0; iteration < ITERATIONS && passed; iteration++) {
+    if(!batching && rnd(8) == 0) {
+      display.beginUpdate();
+      batching = true;
+      for(address = 0; address < 16; address++) {
+        batchRAM[address] = device.getRAM(address);
+      }
+    }
+    if(!randomCall(display, batching)) {
+      // A change from an interrupt waits for the next write.
+      passed = batching ? compare(device, batchRAM, "batched") : compareModel(device, "not yet merged");
+      continue;
+    }
+    if(!strcmp(lastCall, "displayTest()")) {
+      passed = checkTest(display, device);
+    }
+    else if(batching) {
+      passed = compare(device, batchRAM, "batched");      // Nothing is written until the batch ends.
+      if(passed && rnd(4) == 0) {
+        display.endUpdate();
+        batching = false;
+        merge();
+        lastCall = "endUpdate()";
+        passed = compareModel(device, "batch");
+      }
+    }
+    else {
+      merge();
+      passed = compareModel(device, "immediate");
+    }
+  }
+  if(batching) {
+    display.endUpdate();
+  }
+  // Read the key matrix back.
+  for(iteration = 0; iteration < KEY_SCANS && passed; iteration++) {
+    number = rnd(0x1000000);
+    device.setKeyMatrix(number);
+    if(display.readKeyMatrix() != number) {
+      printf("  key matrix 0x%06lx read wrongly\n", (unsigned long)number);
+      passed = false;
+    }
+  }
+  if(device.errors) {
+    printf("  %u protocol errors\n", device.errors);
+    passed = false;
+  }
+  printf("%-32s %6lu checks  %s\n", setup->name, (unsigned long)checks, passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+TM1638Virtual devices[8];
+TM1638 display0(devices[0]), display1(devices[1]), display2(devices[2]), display3(devices[3]);
+TM1638T<4, 8> display4(devices[4]);
+TM1638T<6, 8, 8, reverseMap> display5(devices[5]);
+// The bit banged set ups, with the virtual TM1638s fed from the pin edges.
+TM1638Pins pins6(devices[6], STBPIN, CLKPIN, DIOPIN), pins7(devices[7], STB2PIN, CLKPIN, DIOPIN);
+TM1638 display6(STBPIN, CLKPIN, DIOPIN);
+TM1638PortIO<STB2PIN, CLKPIN, DIOPIN> portIO;
+TM1638T<6, 8, 8, reverseMap> display7(portIO);
+
+int main(void) {
+  bool passed = true;
+  passed &= fuzz(setups[0], display0, devices[0]);
+  passed &= fuzz(setups[1], display1, devices[1]);
+  passed &= fuzz(setups[2], display2, devices[2]);
+  passed &= fuzz(setups[3], display3, devices[3]);
+  passed &= fuzz(setups[4], display4, devices[4]);
+  passed &= fuzz(setups[5], display5, devices[5]);
+  passed &= fuzz(setups[6], display6, devices[6]);
+  passed &= fuzz(setups[7], display7, devices[7]);
+  return passed ? 0 : 1;
+}
+
+// EOF